@@ -6,6 +6,8 @@
 #include <android_image.h>
 #include <image-android-dt.h>
 #include <dt_table.h>
+#include "nvram.h"
+#include "dr_bootstage.h"
 
 /* Depends:
  * SYS_BOOT_DEV --> boot device num
@@ -46,8 +48,13 @@ static int validate_avb(int slot, AvbSlotVerifyData** out_data)
 	}
 	printf("ANDROID: locked: %s\n", unlocked ? "no" : "yes");
 
+	dr_bootstage_start(DR_BOOTSTAGE_AVB_VERIFY);
 	slot_result = avb_slot_verify(avb_ops, requested_partitions, slot_suffix,
 				unlocked, AVB_HASHTREE_ERROR_MODE_RESTART_AND_INVALIDATE, out_data);
+	size_t verified = 0;
+	for (size_t i = 0; *out_data && i < (*out_data)->num_loaded_partitions; ++i)
+		verified += (*out_data)->loaded_partitions[i].data_size;
+	dr_bootstage_end(DR_BOOTSTAGE_AVB_VERIFY, verified);
 	switch (slot_result) {
 	case AVB_SLOT_VERIFY_RESULT_OK:
 		printf("ANDROID: AVB verification successful\n");
@@ -127,7 +134,9 @@ static int load_kernel(const struct boot_img_hdr_v3* hdr_v3, const struct vendor
 		return -EFAULT;
 	}
 	printf("ANDROID: load kernel to         0x%08lx, size: %" PRIu32 "\n", loadaddr, size);
+	dr_bootstage_start(DR_BOOTSTAGE_LOAD_KERNEL);
 	memcpy((void*) loadaddr, (void*) addr, size);
+	dr_bootstage_end(DR_BOOTSTAGE_LOAD_KERNEL, size);
 
 	return 0;
 }
@@ -138,14 +147,18 @@ static int load_ramdisk(const struct boot_img_hdr_v3* hdr_v3, const struct vendo
 		const ulong vendor_ramdisk_loadaddr = (ulong) vendor_hdr_v3->ramdisk_addr;
 		printf("ANDROID: load vendor ramdisk to 0x%08" PRIx32 ", size: %" PRIu32 "\n", vendor_hdr_v3->ramdisk_addr, vendor_hdr_v3->vendor_ramdisk_size);
 		const ulong vendor_ramdisk_start = (ulong) vendor_hdr_v3 + ALIGN(sizeof(struct vendor_boot_img_hdr_v3), vendor_hdr_v3->page_size);
+		dr_bootstage_start(DR_BOOTSTAGE_LOAD_RAMDISK);
 		memcpy((void*) vendor_ramdisk_loadaddr, (void*) vendor_ramdisk_start, vendor_hdr_v3->vendor_ramdisk_size);
+		dr_bootstage_end(DR_BOOTSTAGE_LOAD_RAMDISK, vendor_hdr_v3->vendor_ramdisk_size);
 	}
 
 	if (hdr_v3->ramdisk_size) {
 		const ulong ramdisk_loadaddr = (ulong) vendor_hdr_v3->ramdisk_addr + vendor_hdr_v3->vendor_ramdisk_size;
 		printf("ANDROID: load boot ramdisk to   0x%08lx, size: %" PRIu32 "\n", ramdisk_loadaddr, hdr_v3->ramdisk_size);
 		const ulong ramdisk_start = (ulong) hdr_v3 + BOOT_IMAGE_HDR_V3_SIZE + ALIGN(hdr_v3->kernel_size, vendor_hdr_v3->page_size);
+		dr_bootstage_start(DR_BOOTSTAGE_LOAD_RAMDISK);
 		memcpy((void*) ramdisk_loadaddr, (void*) ramdisk_start, hdr_v3->ramdisk_size);
+		dr_bootstage_end(DR_BOOTSTAGE_LOAD_RAMDISK, hdr_v3->ramdisk_size);
 	}
 
 	return 0;
@@ -169,7 +182,9 @@ static int load_fdt(const AvbPartitionData* avb_dtbo, u32 dtbo_index, ulong load
 		return -EFAULT;
 	}
 	printf("ANDROID: load dtb to            0x%08lx, size %" PRIu32 "\n", loadaddr, size);
+	dr_bootstage_start(DR_BOOTSTAGE_LOAD_FDT);
 	memcpy((void *) loadaddr, (void *) addr, size);
+	dr_bootstage_end(DR_BOOTSTAGE_LOAD_FDT, size);
 
 	return 0;
 }
@@ -225,6 +240,12 @@ static int load_android(AvbSlotVerifyData* avb_data)
 	sprintf(boot_addr_start, "0x%" PRIx32 "", vendor_hdr_v3->kernel_addr);
 	sprintf(ramdisk_addr, "0x%" PRIx32 ":0x%" PRIx32 "", vendor_hdr_v3->ramdisk_addr, vendor_hdr_v3->vendor_ramdisk_size + hdr_v3->ramdisk_size);
 	sprintf(fdt_addr_start, "0x%lx", fdt_addr);
+	/* Write nvram changes deferred during this boot */
+	if (IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT)) {
+		r = nvram_flush();
+		if (r && r != -ENXIO)
+			printf("ANDROID: failed commiting nvram: %d\n", r);
+	}
 	do_booti(NULL, 0, 4, boot_args);
 
 	return -EFAULT;
@@ -245,7 +266,9 @@ static int do_android_boot(struct cmd_tbl* cmdtp, int flag, int argc,
 		goto exit;
 	}
 
+	dr_bootstage_start(DR_BOOTSTAGE_PART_LOOKUP);
 	r = part_get_info_by_name(slot_dev, "misc", &slot_part);
+	dr_bootstage_end(DR_BOOTSTAGE_PART_LOOKUP, 0);
 	if (r < 1) {
 		printf("ANDROID: misc partition not found on %s:%d\n", SYS_BOOT_IFACE, SYS_BOOT_DEV);
 		goto exit;
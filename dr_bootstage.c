@@ -0,0 +1,119 @@
+#include <common.h>
+#include <bootstage.h>
+#include <event.h>
+#include <fdt_support.h>
+#include <time.h>
+#include <inttypes.h>
+#include <linux/libfdt.h>
+#include <dm/ofnode.h>
+#include "dr_bootstage.h"
+
+#if CONFIG_IS_ENABLED(BOOTSTAGE)
+/* Ids past the user range would collide with BOOTSTAGE_ID_ALLOC ones */
+_Static_assert(DR_BOOTSTAGE_COUNT <= CONFIG_BOOTSTAGE_USER_COUNT,
+	"DR_BOOTSTAGE needs BOOTSTAGE_USER_COUNT >= DR_BOOTSTAGE_COUNT");
+#endif
+
+struct dr_stage {
+	const char *name;
+	uint64_t start; /* timer_get_us() of running stage, 0 if not running */
+	uint64_t time_us;
+	uint64_t bytes;
+	uint32_t count;
+};
+
+/* Names double as bootstage names and /chosen/dr,bootstage subnodes */
+static struct dr_stage stages[DR_BOOTSTAGE_COUNT] = {
+	[DR_BOOTSTAGE_NVRAM_INIT] = { .name = "nvram-init" },
+	[DR_BOOTSTAGE_NVRAM_READ] = { .name = "nvram-read" },
+	[DR_BOOTSTAGE_NVRAM_DESERIALIZE] = { .name = "nvram-deserialize" },
+	[DR_BOOTSTAGE_NVRAM_COMMIT] = { .name = "nvram-commit" },
+	[DR_BOOTSTAGE_NVRAM_WRITE] = { .name = "nvram-write" },
+	[DR_BOOTSTAGE_PART_LOOKUP] = { .name = "part-lookup" },
+	[DR_BOOTSTAGE_FIT_READ] = { .name = "fit-read" },
+	[DR_BOOTSTAGE_AVB_VERIFY] = { .name = "avb-verify" },
+	[DR_BOOTSTAGE_LOAD_KERNEL] = { .name = "load-kernel" },
+	[DR_BOOTSTAGE_LOAD_RAMDISK] = { .name = "load-ramdisk" },
+	[DR_BOOTSTAGE_LOAD_FDT] = { .name = "load-fdt" },
+};
+
+void dr_bootstage_start(enum dr_bootstage_id id)
+{
+	if (id >= DR_BOOTSTAGE_COUNT)
+		return;
+	bootstage_start(BOOTSTAGE_ID_USER + id, stages[id].name);
+	stages[id].start = timer_get_us();
+}
+
+void dr_bootstage_end(enum dr_bootstage_id id, uint64_t bytes)
+{
+	if (id >= DR_BOOTSTAGE_COUNT || !stages[id].start)
+		return;
+	bootstage_accum(BOOTSTAGE_ID_USER + id);
+	stages[id].time_us += timer_get_us() - stages[id].start;
+	stages[id].start = 0;
+	stages[id].bytes += bytes;
+	stages[id].count++;
+}
+
+void dr_bootstage_report(void)
+{
+	printf("%-18s %10s %12s %5s\n", "stage", "us", "bytes", "runs");
+	for (int i = 0; i < DR_BOOTSTAGE_COUNT; ++i) {
+		const struct dr_stage *stage = &stages[i];
+		if (!stage->count)
+			continue;
+		printf("%-18s %10" PRIu64 " %12" PRIu64 " %5" PRIu32 "\n", stage->name, stage->time_us, stage->bytes, stage->count);
+	}
+}
+
+#if IS_ENABLED(CONFIG_EVENT) && IS_ENABLED(CONFIG_OF_LIBFDT)
+/*
+ * /chosen/dr,bootstage/<stage> with "time-us", "bytes" and "count" for
+ * each stage run, for collection by Linux userspace.
+ */
+static int dr_bootstage_fdt_fixup(void* blob)
+{
+	/* Three u64/u32 properties and a name per stage */
+	int r = fdt_increase_size(blob, DR_BOOTSTAGE_COUNT * 128);
+	if (r < 0)
+		return r;
+	int chosen = fdt_find_or_add_subnode(blob, 0, "chosen");
+	if (chosen < 0)
+		return chosen;
+	int parent = fdt_find_or_add_subnode(blob, chosen, "dr,bootstage");
+	if (parent < 0)
+		return parent;
+	for (int i = 0; i < DR_BOOTSTAGE_COUNT; ++i) {
+		const struct dr_stage *stage = &stages[i];
+		if (!stage->count)
+			continue;
+		const int node = fdt_find_or_add_subnode(blob, parent, stage->name);
+		if (node < 0)
+			return node;
+		r = fdt_setprop_u64(blob, node, "time-us", stage->time_us);
+		if (!r)
+			r = fdt_setprop_u64(blob, node, "bytes", stage->bytes);
+		if (!r)
+			r = fdt_setprop_u32(blob, node, "count", stage->count);
+		if (r)
+			return r;
+	}
+	return 0;
+}
+
+static int dr_bootstage_ft_fixup(void* ctx, struct event* event)
+{
+	void *blob = oftree_lookup_fdt(event->data.ft_fixup.tree);
+	/* Timings are informational, don't fail the boot */
+	if (!blob) {
+		printf("bootstage: no flat devicetree, timings not passed to OS\n");
+		return 0;
+	}
+	const int r = dr_bootstage_fdt_fixup(blob);
+	if (r)
+		printf("bootstage: failed updating /chosen: %s\n", fdt_strerror(r));
+	return 0;
+}
+EVENT_SPY(EVT_FT_FIXUP, dr_bootstage_ft_fixup);
+#endif
@@ -0,0 +1,56 @@
+#ifndef __DR_BOOTSTAGE_H__
+#define __DR_BOOTSTAGE_H__
+
+#include <stdint.h>
+
+/*
+ * Boot stages timed with CONFIG_DR_BOOTSTAGE. Recorded as bootstage
+ * BOOTSTAGE_ID_USER + id, which must stay below BOOTSTAGE_ID_ALLOC, and
+ * kept with byte counts for "system_load --timings" and
+ * /chosen/dr,bootstage. Keep DR_BOOTSTAGE_COUNT in sync with the
+ * BOOTSTAGE_USER_COUNT requirement of DR_BOOTSTAGE in Kconfig.
+ */
+enum dr_bootstage_id {
+	DR_BOOTSTAGE_NVRAM_INIT,
+	DR_BOOTSTAGE_NVRAM_READ,
+	DR_BOOTSTAGE_NVRAM_DESERIALIZE,
+	DR_BOOTSTAGE_NVRAM_COMMIT,
+	DR_BOOTSTAGE_NVRAM_WRITE,
+	DR_BOOTSTAGE_PART_LOOKUP,
+	DR_BOOTSTAGE_FIT_READ,
+	DR_BOOTSTAGE_AVB_VERIFY,
+	DR_BOOTSTAGE_LOAD_KERNEL,
+	DR_BOOTSTAGE_LOAD_RAMDISK,
+	DR_BOOTSTAGE_LOAD_FDT,
+	DR_BOOTSTAGE_COUNT,
+};
+
+#if IS_ENABLED(CONFIG_DR_BOOTSTAGE)
+/**
+ * dr_bootstage_start() - start timing a stage
+ *
+ * Stages may run several times, time and bytes are accumulated.
+ *
+ * @id: Stage
+ */
+void dr_bootstage_start(enum dr_bootstage_id id);
+
+/**
+ * dr_bootstage_end() - stop timing a stage started by dr_bootstage_start()
+ *
+ * @id: Stage
+ * @bytes: Bytes read, written or copied by this run of the stage
+ */
+void dr_bootstage_end(enum dr_bootstage_id id, uint64_t bytes);
+
+/**
+ * dr_bootstage_report() - print time and bytes of all stages run
+ */
+void dr_bootstage_report(void);
+#else
+static inline void dr_bootstage_start(enum dr_bootstage_id id) {}
+static inline void dr_bootstage_end(enum dr_bootstage_id id, uint64_t bytes) {}
+static inline void dr_bootstage_report(void) {}
+#endif
+
+#endif // __DR_BOOTSTAGE_H__
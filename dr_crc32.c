@@ -0,0 +1,26 @@
+#include <common.h>
+#include <u-boot/crc.h>
+#include "dr_crc32.h"
+
+/*
+ * U-Boot crc32() keeps its table const and uses the ARMv8 crc32
+ * instructions with CONFIG_ARM64_CRC32, so it is safe before relocation.
+ */
+uint32_t dr_crc32(uint32_t crc, const uint8_t* buf, size_t len)
+{
+	return crc32(crc, buf, len);
+}
+
+#if defined(CONFIG_SPL_BUILD) ? IS_ENABLED(CONFIG_SPL_LIBNVRAM) : IS_ENABLED(CONFIG_DR_NVRAM)
+#include "libnvram/crc32.h"
+
+/*
+ * libnvram/crc32.o is not linked, libnvram gets its crc32 from here.
+ * Its header is included above so a changed prototype fails to build
+ * instead of checking sections with the wrong arguments.
+ */
+uint32_t calc_crc32(const uint8_t* data, uint32_t len)
+{
+	return dr_crc32(0, data, len);
+}
+#endif
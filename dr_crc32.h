@@ -0,0 +1,19 @@
+#ifndef __DR_CRC32_H__
+#define __DR_CRC32_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * dr_crc32() - zlib compatible crc32
+ *
+ * U-Boot crc32(), with the ARMv8 crc32 instructions if CONFIG_ARM64_CRC32.
+ *
+ * @crc: crc32 of preceding data, 0 to start
+ * @buf: Data
+ * @len: Length of data
+ * @return crc32 of preceding data and buf
+ */
+uint32_t dr_crc32(uint32_t crc, const uint8_t* buf, size_t len);
+
+#endif // __DR_CRC32_H__
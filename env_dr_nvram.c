@@ -0,0 +1,144 @@
+#include <common.h>
+#include <env.h>
+#include <env_internal.h>
+#include <errno.h>
+#include <malloc.h>
+#include <search.h>
+#include <linux/ctype.h>
+#include <asm/global_data.h>
+#include "nvram.h"
+#include "libnvram/libnvram.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/*
+ * Environment stored as nvram variables CONFIG_ENV_DR_NVRAM_PREFIX<name>,
+ * sharing the nvram list already loaded for nvram_get().
+ * Requires ENVL_DR_NVRAM in enum env_location of the U-Boot tree.
+ */
+static const char *env_prefix = CONFIG_ENV_DR_NVRAM_PREFIX;
+
+/* Returns env name of nvram entry, or NULL if not part of environment */
+static const char* env_name(const struct libnvram_entry* entry)
+{
+	const size_t prefix_len = strlen(env_prefix);
+	const char *key = (const char*) entry->key;
+	if (entry->key_len <= prefix_len + 1)
+		return NULL;
+	/* Key comes from flash, only use it as string if terminated at key_len */
+	if (memchr(key, '\0', entry->key_len) != key + entry->key_len - 1)
+		return NULL;
+	if (memcmp(key, env_prefix, prefix_len))
+		return NULL;
+	/* Only printable strings */
+	if (!nvram_get(key))
+		return NULL;
+	return key + prefix_len;
+}
+
+/* nvram only stores printable values, multi-line env values can't be saved */
+static int is_storable(const char* value)
+{
+	for (; *value; ++value) {
+		if (!isprint(*value) && !isblank(*value))
+			return 0;
+	}
+	return 1;
+}
+
+static int env_dr_nvram_load(void)
+{
+	const int r = nvram_import_env(env_prefix, env_prefix, "", H_EXTERNAL);
+	if (r) {
+		env_set_default(r == -ENOENT ? "no environment in nvram"
+					: "nvram environment import failed", 0);
+		return r;
+	}
+	gd->flags |= GD_FLG_ENV_READY;
+
+	return 0;
+}
+
+static int env_dr_nvram_save(void)
+{
+	const size_t prefix_len = strlen(env_prefix);
+	const char **vars = NULL;
+	char *names = NULL;
+	char *data = NULL;
+	int count = 0;
+	int r = 0;
+
+	if (!strncmp(env_prefix, "SYS_", 4)) {
+		printf("nvram: environment prefix %s not allowed\n", env_prefix);
+		return -EINVAL;
+	}
+
+	ssize_t len = hexport_r(&env_htab, '\0', 0, &data, 0, 0, NULL);
+	if (len < 0)
+		return -EINVAL;
+
+	/* All env variables to set, and stale nvram env variables to delete */
+	int max = 0;
+	for (char *p = data; p < data + len && *p; p += strlen(p) + 1)
+		max++;
+	for (struct libnvram_list* cur = nvram_get_list(); cur; cur = cur->next) {
+		if (env_name(cur->entry))
+			max++;
+	}
+	vars = calloc(2 * max, sizeof(char*));
+	names = malloc(len + max * prefix_len);
+	if (!vars || !names) {
+		r = -ENOMEM;
+		goto exit;
+	}
+
+	char *name = names;
+	for (char *p = data; p < data + len && *p; p += strlen(p) + 1) {
+		char *value = strchr(p, '=');
+		if (!value)
+			continue;
+		*value++ = '\0';
+		vars[2 * count] = name;
+		vars[2 * count + 1] = value;
+		if (!is_storable(value)) {
+			/* Drop any older copy rather than bring back a stale value */
+			printf("nvram: env %s not saved, value not printable\n", p);
+			vars[2 * count + 1] = NULL;
+		}
+		name += sprintf(name, "%s%s", env_prefix, p) + 1;
+		count++;
+		/* Restore so p + strlen(p) keeps walking the export */
+		value[-1] = '=';
+	}
+	for (struct libnvram_list* cur = nvram_get_list(); cur; cur = cur->next) {
+		const char *env = env_name(cur->entry);
+		if (env && !env_get(env)) {
+			vars[2 * count] = (const char*) cur->entry->key;
+			vars[2 * count + 1] = NULL;
+			count++;
+		}
+	}
+
+	if (count && nvram_set_batch_prefix(env_prefix, vars, count)) {
+		r = -EINVAL;
+		goto exit;
+	}
+	/* saveenv is expected to be durable, don't defer */
+	r = nvram_flush();
+
+exit:
+	if (vars)
+		free(vars);
+	if (names)
+		free(names);
+	if (data)
+		free(data);
+	return r;
+}
+
+U_BOOT_ENV_LOCATION(dr_nvram) = {
+	.location	= ENVL_DR_NVRAM,
+	ENV_NAME("DR_NVRAM")
+	.load		= env_dr_nvram_load,
+	.save		= ENV_SAVE_PTR(env_dr_nvram_save),
+};
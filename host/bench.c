@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+#include "bench.h"
+
+uint64_t bench_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void bench_report(const char* name, uint64_t size, uint64_t ops, uint64_t ns)
+{
+	static int header;
+	if (!header) {
+		printf("%-20s %8s %8s %12s %10s %12s\n", "bench", "size", "ops", "ns/op", "allocs/op", "peak-heap");
+		header = 1;
+	}
+	printf("%-20s %8" PRIu64 " %8" PRIu64 " %12.1f %10.2f %12zu\n", name, size, ops,
+		ops ? (double) ns / ops : 0.0, ops ? (double) heap.allocs / ops : 0.0, heap.peak - heap.base);
+}
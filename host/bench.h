@@ -0,0 +1,25 @@
+#ifndef __HOST_BENCH_H__
+#define __HOST_BENCH_H__
+
+#include <stdint.h>
+#include "heap.h"
+
+/**
+ * bench_ns() - monotonic time in ns
+ */
+uint64_t bench_ns(void);
+
+/**
+ * bench_report() - print one result line, header before the first
+ *
+ * Allocations are per op, peak heap is the highest heap use above the
+ * level at heap_mark().
+ *
+ * @name: Benchmark
+ * @size: Keys, bytes or entries the benchmark ran on
+ * @ops: Operations timed
+ * @ns: Total time of ops
+ */
+void bench_report(const char* name, uint64_t size, uint64_t ops, uint64_t ns);
+
+#endif // __HOST_BENCH_H__
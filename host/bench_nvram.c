@@ -0,0 +1,167 @@
+/*
+ * nvram_init(), nvram_get(), nvram_set() and commit on RAM backed MTD
+ * sections, from 10 to 10000 keys. nvram.c is built into this program so
+ * the list can be released and loaded again between runs.
+ * Built as bench_nvram_gzip with CONFIG_DR_NVRAM_COMPRESS, the flash
+ * table compares image size and flash traffic of the two.
+ */
+#include "../nvram.c"
+#include "bench.h"
+
+#define ERASESIZE 4096
+#define WRITESIZE 1
+#define GET_OPS 200000
+
+static const uint32_t key_counts[] = { 10, 100, 1000, 10000 };
+
+/* Image and flash traffic per single change commit, by key count */
+struct flash_stats {
+	size_t image_len;
+	uint64_t program_bytes;
+	uint64_t erase_bytes;
+};
+
+static struct flash_stats flash[ARRAY_SIZE(key_counts)];
+
+static char (*names)[24];
+static char (*values)[32];
+
+static void make_vars(uint32_t count, uint32_t round)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		snprintf(names[i], sizeof(names[i]), "SYS_BENCH_%05" PRIu32, i);
+		snprintf(values[i], sizeof(values[i]), "value-%08" PRIx32 "-%" PRIu32, i * 2654435761u, round);
+	}
+}
+
+/* Sections sized for the list plus room for the same again */
+static int make_flash(uint32_t count)
+{
+	const uint64_t size = ALIGN((uint64_t) count * 2 * (2 * sizeof(uint32_t) + sizeof(names[0]) + sizeof(values[0])) + ERASESIZE, ERASESIZE);
+	host_mtd_remove_all();
+	if (!host_mtd_add("system_a", size, ERASESIZE, WRITESIZE) || !host_mtd_add("system_b", size, ERASESIZE, WRITESIZE))
+		return -ENOMEM;
+	return 0;
+}
+
+static void bench_keys(uint32_t count, int mapped, struct flash_stats* stats)
+{
+	char name[32];
+	uint64_t ns = 0;
+
+	nvram_release();
+	if (make_flash(count)) {
+		printf("bench: no memory for %" PRIu32 " keys\n", count);
+		exit(1);
+	}
+	for (struct mtd_info *mtd = __mtd_next_device(0); mtd; mtd = __mtd_next_device(mtd->index + 1))
+		mtd->pointable = mapped;
+
+	/* Initial list, nvram_set() of new keys */
+	make_vars(count, 0);
+	nvram_init();
+	heap_mark();
+	ns = bench_ns();
+	for (uint32_t i = 0; i < count; ++i) {
+		if (nvram_set(names[i], values[i]))
+			exit(1);
+	}
+	ns = bench_ns() - ns;
+	snprintf(name, sizeof(name), "set-new%s", mapped ? "-mapped" : "");
+	bench_report(name, count, count, ns);
+
+	heap_mark();
+	ns = bench_ns();
+	if (nvram_commit())
+		exit(1);
+	ns = bench_ns() - ns;
+	snprintf(name, sizeof(name), "commit-all%s", mapped ? "-mapped" : "");
+	bench_report(name, count, 1, ns);
+
+	/* Load from flash, released in between */
+	const uint32_t init_ops = max(3u, 20000 / count);
+	nvram_release();
+	heap_mark();
+	ns = 0;
+	for (uint32_t i = 0; i < init_ops; ++i) {
+		const uint64_t start = bench_ns();
+		if (nvram_init())
+			exit(1);
+		ns += bench_ns() - start;
+		if (i + 1 < init_ops)
+			nvram_release();
+	}
+	snprintf(name, sizeof(name), "init%s", mapped ? "-mapped" : "");
+	bench_report(name, count, init_ops, ns);
+
+	heap_mark();
+	ns = bench_ns();
+	for (uint32_t i = 0; i < GET_OPS; ++i) {
+		if (!nvram_get(names[i % count]))
+			exit(1);
+	}
+	ns = bench_ns() - ns;
+	snprintf(name, sizeof(name), "get%s", mapped ? "-mapped" : "");
+	bench_report(name, count, GET_OPS, ns);
+
+	/* Update every key, copy on write */
+	make_vars(count, 1);
+	heap_mark();
+	ns = bench_ns();
+	for (uint32_t i = 0; i < count; ++i) {
+		if (nvram_set(names[i], values[i]))
+			exit(1);
+	}
+	ns = bench_ns() - ns;
+	snprintf(name, sizeof(name), "set-update%s", mapped ? "-mapped" : "");
+	bench_report(name, count, count, ns);
+
+	/* Single change per commit, as a boot attempt counter */
+	const uint32_t commit_ops = 20;
+	const uint64_t program_start = host_mtd_program_bytes;
+	const uint64_t erase_start = host_mtd_erase_bytes;
+	heap_mark();
+	ns = 0;
+	for (uint32_t i = 0; i < commit_ops; ++i) {
+		if (nvram_set_ulong("SYS_BOOT_ATTEMPTS", i + 1))
+			exit(1);
+		const uint64_t start = bench_ns();
+		if (nvram_commit())
+			exit(1);
+		ns += bench_ns() - start;
+	}
+	snprintf(name, sizeof(name), "commit-one%s", mapped ? "-mapped" : "");
+	bench_report(name, count, commit_ops, ns);
+	if (stats) {
+		stats->image_len = nvram->image_len;
+		stats->program_bytes = (host_mtd_program_bytes - program_start) / commit_ops;
+		stats->erase_bytes = (host_mtd_erase_bytes - erase_start) / commit_ops;
+	}
+
+	nvram_release();
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t max_count = key_counts[ARRAY_SIZE(key_counts) - 1];
+	names = malloc(max_count * sizeof(names[0]));
+	values = malloc(max_count * sizeof(values[0]));
+	if (!names || !values)
+		return 1;
+
+	for (size_t i = 0; i < ARRAY_SIZE(key_counts); ++i)
+		bench_keys(key_counts[i], 0, &flash[i]);
+	for (size_t i = 0; i < ARRAY_SIZE(key_counts); ++i)
+		bench_keys(key_counts[i], 1, NULL);
+
+	printf("\n%-20s %8s %12s %14s %14s\n", IS_ENABLED(CONFIG_DR_NVRAM_COMPRESS) ? "flash (gzip)" : "flash",
+		"keys", "image-bytes", "program/commit", "erase/commit");
+	for (size_t i = 0; i < ARRAY_SIZE(key_counts); ++i)
+		printf("%-20s %8" PRIu32 " %12zu %14" PRIu64 " %14" PRIu64 "\n", "commit-one", key_counts[i],
+			flash[i].image_len, flash[i].program_bytes, flash[i].erase_bytes);
+
+	host_mtd_remove_all();
+	free(names);
+	free(values);
+	return 0;
+}
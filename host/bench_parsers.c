@@ -0,0 +1,180 @@
+/*
+ * parse_header() and parse_dram_timing_info().
+ *
+ *   bench_parsers [platform-header-image]
+ *
+ * With an image, as written to the platform header partition, its header
+ * and DDR timing blob are parsed. Without, a generated header and a blob
+ * shaped like an i.MX8M LPDDR4 timing are used.
+ */
+#include <common.h>
+#include <zlib.h>
+#include "../platform_header.h"
+#include "../imx8m_ddrc_parse.h"
+#include "bench.h"
+
+#define PARSE_OPS 100000
+
+/* Entry counts close to NXP lpddr4_timing.c of i.MX8M Mini EVK */
+#define DDRC_CFG_NUM 112
+#define DDRPHY_CFG_NUM 88
+#define FSP_MSG_NUM 3
+#define FSP_CFG_NUM 40
+#define TRAINED_CSR_NUM 740
+#define DDRPHY_PIE_NUM 580
+
+static void u32tole(uint32_t value, uint8_t* le)
+{
+	le[0] = value & 0xff;
+	le[1] = (value >> 8) & 0xff;
+	le[2] = (value >> 16) & 0xff;
+	le[3] = (value >> 24) & 0xff;
+}
+
+static size_t put_cfg(uint8_t* buf, uint32_t num)
+{
+	size_t pos = 0;
+	u32tole(num, buf + pos);
+	pos += sizeof(uint32_t);
+	for (uint32_t i = 0; i < num; ++i) {
+		u32tole(0x3d400000 + 4 * i, buf + pos);
+		u32tole(i * 2654435761u, buf + pos + sizeof(uint32_t));
+		pos += 2 * sizeof(uint32_t);
+	}
+	return pos;
+}
+
+/* Layout read by parse_dram_timing_info(), buf NULL to get the size */
+static size_t make_timing(uint8_t* buf)
+{
+	uint8_t *tmp = buf ? buf : malloc(1024 * 1024);
+	size_t pos = 0;
+	pos += put_cfg(tmp + pos, DDRC_CFG_NUM);
+	pos += put_cfg(tmp + pos, DDRPHY_CFG_NUM);
+	u32tole(FSP_MSG_NUM, tmp + pos);
+	pos += sizeof(uint32_t);
+	for (uint32_t i = 0; i < FSP_MSG_NUM; ++i) {
+		u32tole(3000 >> i, tmp + pos);
+		u32tole(i == FSP_MSG_NUM - 1, tmp + pos + 4);
+		u32tole(FSP_CFG_NUM, tmp + pos + 8);
+		pos += 3 * sizeof(uint32_t);
+	}
+	for (uint32_t i = 0; i < FSP_MSG_NUM; ++i)
+		pos += put_cfg(tmp + pos, FSP_CFG_NUM) - sizeof(uint32_t);
+	pos += put_cfg(tmp + pos, TRAINED_CSR_NUM);
+	pos += put_cfg(tmp + pos, DDRPHY_PIE_NUM);
+	for (uint32_t i = 0; i < 4; ++i) {
+		u32tole(i < FSP_MSG_NUM ? 3000 >> i : 0, tmp + pos);
+		pos += sizeof(uint32_t);
+	}
+	if (!buf)
+		free(tmp);
+	return pos;
+}
+
+static void make_header(uint8_t* buf)
+{
+	memset(buf, 0, PLATFORM_HEADER_SIZE);
+	u32tole(PLATFORM_HEADER_MAGIC, buf + offsetof(struct platform_header, hdr_magic));
+	strcpy((char*) buf + offsetof(struct platform_header, name), "bench");
+	u32tole(PLATFORM_HEADER_SIZE, buf + offsetof(struct platform_header, total_size));
+	u32tole(crc32(0, buf, offsetof(struct platform_header, hdr_crc32)), buf + offsetof(struct platform_header, hdr_crc32));
+}
+
+static void free_timing(struct dram_timing_info* info)
+{
+	free(info->ddrc_cfg);
+	free(info->ddrphy_cfg);
+	for (unsigned int i = 0; i < info->fsp_msg_num; ++i)
+		free(info->fsp_msg[i].fsp_cfg);
+	free(info->fsp_msg);
+	free(info->ddrphy_trained_csr);
+	free(info->ddrphy_pie);
+}
+
+static uint8_t* read_file(const char* path, size_t* len)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *buf = malloc(*len);
+	if (buf && fread(buf, 1, *len, f) != *len) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	return buf;
+}
+
+int main(int argc, char* argv[])
+{
+	uint8_t *image = NULL;
+	size_t image_len = 0;
+	uint8_t header_buf[PLATFORM_HEADER_SIZE];
+	const uint8_t *header = header_buf;
+	uint8_t *timing = NULL;
+	size_t timing_len = 0;
+	int timing_owned = 0;
+	struct platform_header hdr;
+	int r = 0;
+
+	if (argc > 1) {
+		image = read_file(argv[1], &image_len);
+		if (!image || image_len < PLATFORM_HEADER_SIZE) {
+			printf("bench: failed reading %s\n", argv[1]);
+			return 1;
+		}
+		header = image;
+		if (parse_header(&hdr, header, PLATFORM_HEADER_SIZE)) {
+			printf("bench: invalid platform header in %s\n", argv[1]);
+			return 1;
+		}
+		if (hdr.ddrc_blob_size && hdr.ddrc_blob_offset <= image_len
+			&& hdr.ddrc_blob_size <= image_len - hdr.ddrc_blob_offset) {
+			timing = image + hdr.ddrc_blob_offset;
+			timing_len = hdr.ddrc_blob_size;
+		}
+	}
+	else {
+		make_header(header_buf);
+	}
+	if (!timing) {
+		timing_len = make_timing(NULL);
+		timing = malloc(timing_len);
+		if (!timing)
+			return 1;
+		make_timing(timing);
+		timing_owned = 1;
+	}
+
+	heap_mark();
+	uint64_t ns = bench_ns();
+	for (int i = 0; i < PARSE_OPS; ++i)
+		r |= parse_header(&hdr, header, PLATFORM_HEADER_SIZE);
+	bench_report("parse_header", PLATFORM_HEADER_SIZE, PARSE_OPS, bench_ns() - ns);
+
+	struct dram_timing_info info;
+	const int timing_ops = PARSE_OPS / 10;
+	heap_mark();
+	ns = 0;
+	for (int i = 0; i < timing_ops; ++i) {
+		memset(&info, 0, sizeof(info));
+		const uint64_t start = bench_ns();
+		r |= parse_dram_timing_info(&info, timing, timing_len);
+		ns += bench_ns() - start;
+		if (!r)
+			free_timing(&info);
+	}
+	bench_report("parse_dram_timing", timing_len, timing_ops, ns);
+
+	if (r)
+		printf("bench: parse failed\n");
+	if (timing_owned)
+		free(timing);
+	if (image)
+		free(image);
+	return r ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Devicetree stand-in and events, see include/linux/libfdt.h and
+ * include/event.h.
+ */
+#include <common.h>
+#include <event.h>
+#include <fdt_support.h>
+#include <linux/libfdt.h>
+
+void host_fdt_init(struct host_fdt* fdt)
+{
+	memset(fdt, 0, sizeof(struct host_fdt));
+	fdt->nodes = 1;
+	fdt->parent[0] = -1;
+}
+
+void host_fdt_free(struct host_fdt* fdt)
+{
+	for (int i = 0; i < fdt->props; ++i)
+		free(fdt->prop[i].data);
+	host_fdt_init(fdt);
+}
+
+static int valid_node(const struct host_fdt* fdt, int node)
+{
+	return node >= 0 && node < fdt->nodes;
+}
+
+int fdt_increase_size(void* fdt, int add_len)
+{
+	return 0;
+}
+
+int fdt_subnode_offset(const void* blob, int parentoffset, const char* name)
+{
+	const struct host_fdt *fdt = blob;
+	for (int i = 1; i < fdt->nodes; ++i) {
+		if (fdt->parent[i] == parentoffset && !strcmp(fdt->name[i], name))
+			return i;
+	}
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_find_or_add_subnode(void* blob, int parentoffset, const char* name)
+{
+	struct host_fdt *fdt = blob;
+	if (!valid_node(fdt, parentoffset))
+		return -FDT_ERR_NOTFOUND;
+	const int node = fdt_subnode_offset(fdt, parentoffset, name);
+	if (node >= 0)
+		return node;
+	if (fdt->nodes == HOST_FDT_MAX || strlen(name) >= sizeof(fdt->name[0]))
+		return -FDT_ERR_NOSPACE;
+	fdt->parent[fdt->nodes] = parentoffset;
+	strcpy(fdt->name[fdt->nodes], name);
+	return fdt->nodes++;
+}
+
+static struct host_fdt_prop *find_prop(const struct host_fdt* fdt, int node, const char* name)
+{
+	for (int i = 0; i < fdt->props; ++i) {
+		if (fdt->prop[i].node == node && !strcmp(fdt->prop[i].name, name))
+			return (struct host_fdt_prop*) &fdt->prop[i];
+	}
+	return NULL;
+}
+
+const void *fdt_getprop(const void* blob, int nodeoffset, const char* name, int* lenp)
+{
+	const struct host_fdt_prop *prop = find_prop(blob, nodeoffset, name);
+	if (lenp)
+		*lenp = prop ? prop->len : -FDT_ERR_NOTFOUND;
+	return prop ? prop->data : NULL;
+}
+
+int fdt_setprop(void* blob, int nodeoffset, const char* name, const void* val, int len)
+{
+	struct host_fdt *fdt = blob;
+	if (!valid_node(fdt, nodeoffset))
+		return -FDT_ERR_NOTFOUND;
+	struct host_fdt_prop *prop = find_prop(fdt, nodeoffset, name);
+	if (!prop) {
+		if (fdt->props == HOST_FDT_MAX || strlen(name) >= sizeof(prop->name))
+			return -FDT_ERR_NOSPACE;
+		prop = &fdt->prop[fdt->props++];
+		prop->node = nodeoffset;
+		strcpy(prop->name, name);
+		prop->data = NULL;
+	}
+	free(prop->data);
+	prop->data = malloc(len ? len : 1);
+	if (!prop->data) {
+		prop->len = 0;
+		return -FDT_ERR_NOSPACE;
+	}
+	memcpy(prop->data, val, len);
+	prop->len = len;
+	return 0;
+}
+
+/* Cells are big endian as in a real blob */
+int fdt_setprop_u32(void* fdt, int nodeoffset, const char* name, uint32_t val)
+{
+	const uint32_t cell = __builtin_bswap32(val);
+	return fdt_setprop(fdt, nodeoffset, name, &cell, sizeof(cell));
+}
+
+int fdt_setprop_u64(void* fdt, int nodeoffset, const char* name, uint64_t val)
+{
+	const uint64_t cells = __builtin_bswap64(val);
+	return fdt_setprop(fdt, nodeoffset, name, &cells, sizeof(cells));
+}
+
+int fdt_setprop_string(void* fdt, int nodeoffset, const char* name, const char* str)
+{
+	return fdt_setprop(fdt, nodeoffset, name, str, strlen(str) + 1);
+}
+
+const char *fdt_strerror(int errval)
+{
+	switch (errval) {
+	case -FDT_ERR_NOTFOUND:
+		return "FDT_ERR_NOTFOUND";
+	case -FDT_ERR_NOSPACE:
+		return "FDT_ERR_NOSPACE";
+	}
+	return "<unknown error>";
+}
+
+/* Bounds of section host_evspy, NULL if no spy is linked in */
+extern struct evspy_info __start_host_evspy[] __attribute__((weak));
+extern struct evspy_info __stop_host_evspy[] __attribute__((weak));
+
+int event_notify(enum event_t type, void* data, int size)
+{
+	struct event event = { .type = type };
+	memcpy(&event.data, data, min((size_t) size, sizeof(event.data)));
+	for (struct evspy_info *spy = __start_host_evspy; spy < __stop_host_evspy; ++spy) {
+		if (spy->type != type)
+			continue;
+		const int r = spy->func(NULL, &event);
+		if (r)
+			return r;
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Heap accounting for benchmarks. Programs are linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free so every
+ * allocation made by the objects built here is counted, libc internals
+ * are not.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "heap.h"
+
+struct heap_stats heap;
+
+/* Size kept in front of each block, max_align_t keeps alignment */
+union heap_hdr {
+	size_t size;
+	max_align_t align;
+};
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static void heap_add(size_t size)
+{
+	heap.allocs++;
+	heap.live += size;
+	if (heap.live > heap.peak)
+		heap.peak = heap.live;
+}
+
+void *__wrap_malloc(size_t size)
+{
+	union heap_hdr *hdr = __real_malloc(sizeof(union heap_hdr) + size);
+	if (!hdr)
+		return NULL;
+	hdr->size = size;
+	heap_add(size);
+	return hdr + 1;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	if (size && nmemb > SIZE_MAX / size)
+		return NULL;
+	void *ptr = __wrap_malloc(nmemb * size);
+	if (ptr)
+		memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+void __wrap_free(void* ptr)
+{
+	if (!ptr)
+		return;
+	union heap_hdr *hdr = (union heap_hdr*) ptr - 1;
+	heap.frees++;
+	heap.live -= hdr->size;
+	__real_free(hdr);
+}
+
+void *__wrap_realloc(void* ptr, size_t size)
+{
+	if (!ptr)
+		return __wrap_malloc(size);
+	union heap_hdr *hdr = (union heap_hdr*) ptr - 1;
+	const size_t old = hdr->size;
+	hdr = __real_realloc(hdr, sizeof(union heap_hdr) + size);
+	if (!hdr)
+		return NULL;
+	hdr->size = size;
+	heap.live -= old;
+	heap_add(size);
+	return hdr + 1;
+}
+
+void heap_mark(void)
+{
+	heap.allocs = 0;
+	heap.frees = 0;
+	heap.peak = heap.live;
+	heap.base = heap.live;
+}
@@ -0,0 +1,22 @@
+#ifndef __HOST_HEAP_H__
+#define __HOST_HEAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct heap_stats {
+	uint64_t allocs; /* malloc, calloc and realloc calls since heap_mark() */
+	uint64_t frees;
+	size_t live; /* Bytes allocated and not freed */
+	size_t peak; /* Highest live since heap_mark() */
+	size_t base; /* live at heap_mark() */
+};
+
+extern struct heap_stats heap;
+
+/**
+ * heap_mark() - start a measurement, peak is reported relative to base
+ */
+void heap_mark(void);
+
+#endif // __HOST_HEAP_H__
@@ -0,0 +1,36 @@
+/* Timing structures of U-Boot arch/arm/include/asm/arch-imx8m/ddr.h */
+#ifndef __HOST_ASM_ARCH_DDR_H__
+#define __HOST_ASM_ARCH_DDR_H__
+
+enum fw_type {
+	FW_1D_IMAGE,
+	FW_2D_IMAGE,
+};
+
+struct dram_cfg_param {
+	unsigned int reg;
+	unsigned int val;
+};
+
+struct dram_fsp_msg {
+	unsigned int drate;
+	enum fw_type fw_type;
+	struct dram_cfg_param *fsp_cfg;
+	unsigned int fsp_cfg_num;
+};
+
+struct dram_timing_info {
+	struct dram_cfg_param *ddrc_cfg;
+	unsigned int ddrc_cfg_num;
+	struct dram_cfg_param *ddrphy_cfg;
+	unsigned int ddrphy_cfg_num;
+	struct dram_fsp_msg *fsp_msg;
+	unsigned int fsp_msg_num;
+	struct dram_cfg_param *ddrphy_trained_csr;
+	unsigned int ddrphy_trained_csr_num;
+	struct dram_cfg_param *ddrphy_pie;
+	unsigned int ddrphy_pie_num;
+	unsigned int fsp_table[4];
+};
+
+#endif // __HOST_ASM_ARCH_DDR_H__
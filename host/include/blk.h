@@ -0,0 +1,8 @@
+#ifndef __HOST_BLK_H__
+#define __HOST_BLK_H__
+
+/* Block device backend is not built on host, types only */
+typedef uint64_t lbaint_t;
+struct blk_desc;
+
+#endif // __HOST_BLK_H__
@@ -0,0 +1,7 @@
+#ifndef __HOST_BLOBLIST_H__
+#define __HOST_BLOBLIST_H__
+
+/* No SPL on host, nothing is ever handed off */
+void *bloblist_find(unsigned int tag, int size);
+
+#endif // __HOST_BLOBLIST_H__
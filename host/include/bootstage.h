@@ -0,0 +1,21 @@
+#ifndef __HOST_BOOTSTAGE_H__
+#define __HOST_BOOTSTAGE_H__
+
+#include <common.h>
+
+/* No bootstage on host, as U-Boot without CONFIG_BOOTSTAGE */
+enum bootstage_id {
+	BOOTSTAGE_ID_USER = 50,
+};
+
+static inline ulong bootstage_start(enum bootstage_id id, const char* name)
+{
+	return 0;
+}
+
+static inline uint32_t bootstage_accum(enum bootstage_id id)
+{
+	return 0;
+}
+
+#endif // __HOST_BOOTSTAGE_H__
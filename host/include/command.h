@@ -0,0 +1,24 @@
+#ifndef __HOST_COMMAND_H__
+#define __HOST_COMMAND_H__
+
+/* Commands are kept in a table entry each, nothing dispatches them on host */
+struct cmd_tbl {
+	const char *name;
+	int maxargs;
+	int (*cmd)(struct cmd_tbl* cmdtp, int flag, int argc, char* const argv[]);
+	const char *usage;
+	const char *help;
+};
+
+enum command_ret_t {
+	CMD_RET_SUCCESS,
+	CMD_RET_FAILURE,
+	CMD_RET_USAGE = -1,
+};
+
+#define U_BOOT_CMD(_name, _maxargs, _rep, _cmd, _usage, _help) \
+	struct cmd_tbl _u_boot_cmd_##_name = { #_name, _maxargs, _cmd, _usage, _help }
+
+int do_bootm(struct cmd_tbl* cmdtp, int flag, int argc, char* const argv[]);
+
+#endif // __HOST_COMMAND_H__
@@ -0,0 +1,37 @@
+/*
+ * Minimal stand-in for U-Boot <common.h>, enough to build the sources of
+ * this repo as host programs. Not a U-Boot API, only what is used here.
+ */
+#ifndef __HOST_COMMON_H__
+#define __HOST_COMMON_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <linux/kconfig.h>
+#include <linux/kernel.h>
+
+typedef unsigned long ulong;
+typedef unsigned char u_char;
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uint64_t resource_size_t;
+
+#define __maybe_unused __attribute__((unused))
+
+/* U-Boot default log level hides pr_info(), set HOST_VERBOSE=1 to see it */
+extern int host_verbose;
+#define pr_err(...) fprintf(stderr, __VA_ARGS__)
+#define pr_info(...) do { if (host_verbose) printf(__VA_ARGS__); } while (0)
+
+ulong simple_strtoul(const char* cp, char** endp, unsigned int base);
+char *simple_itoa(ulong value);
+const char *errno_str(int err);
+
+#endif // __HOST_COMMON_H__
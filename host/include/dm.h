@@ -0,0 +1,27 @@
+#ifndef __HOST_DM_H__
+#define __HOST_DM_H__
+
+#include <dm/ofnode.h>
+
+/* No driver model on host, devices are never found by phandle or name */
+
+struct ofnode_phandle_args {
+	ofnode node;
+	int args_count;
+	uint32_t args[16];
+};
+
+struct udevice;
+
+enum uclass_id {
+	UCLASS_MTD,
+	UCLASS_SPI_FLASH,
+};
+
+ofnode ofnode_path(const char* path);
+int ofnode_parse_phandle_with_args(ofnode node, const char* list_name, const char* cells_name,
+				int cell_count, int index, struct ofnode_phandle_args* out_args);
+int uclass_get_device_by_ofnode(enum uclass_id id, ofnode node, struct udevice** devp);
+int uclass_get_device_by_name(enum uclass_id id, const char* name, struct udevice** devp);
+
+#endif // __HOST_DM_H__
@@ -0,0 +1,24 @@
+#ifndef __HOST_DM_OFNODE_H__
+#define __HOST_DM_OFNODE_H__
+
+/* Nodes are never found on host, trees are always flat */
+typedef struct {
+	int of_offset;
+} ofnode;
+
+typedef struct {
+	void *fdt;
+} oftree;
+
+static inline oftree oftree_from_fdt(void* fdt)
+{
+	oftree tree = { fdt };
+	return tree;
+}
+
+static inline void *oftree_lookup_fdt(oftree tree)
+{
+	return tree.fdt;
+}
+
+#endif // __HOST_DM_OFNODE_H__
@@ -0,0 +1,6 @@
+#ifndef __HOST_ENV_H__
+#define __HOST_ENV_H__
+
+int env_set(const char* varname, const char* value);
+
+#endif // __HOST_ENV_H__
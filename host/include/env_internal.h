@@ -0,0 +1,8 @@
+#ifndef __HOST_ENV_INTERNAL_H__
+#define __HOST_ENV_INTERNAL_H__
+
+#include <search.h>
+
+extern struct hsearch_data env_htab;
+
+#endif // __HOST_ENV_INTERNAL_H__
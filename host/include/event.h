@@ -0,0 +1,42 @@
+#ifndef __HOST_EVENT_H__
+#define __HOST_EVENT_H__
+
+#include <dm/ofnode.h>
+
+/*
+ * Events as U-Boot <event.h>, only EVT_FT_FIXUP. EVENT_SPY() places the
+ * spy in section host_evspy, event_notify() calls all spies of the type.
+ */
+enum event_t {
+	EVT_FT_FIXUP,
+};
+
+struct bootm_headers;
+
+union event_data {
+	struct event_ft_fixup {
+		oftree tree;
+		struct bootm_headers *images;
+	} ft_fixup;
+};
+
+struct event {
+	enum event_t type;
+	union event_data data;
+};
+
+typedef int (*event_handler_t)(void* ctx, struct event* event);
+
+struct evspy_info {
+	event_handler_t func;
+	enum event_t type;
+	const char *id;
+};
+
+#define EVENT_SPY(_type, _func) \
+	static struct evspy_info _func##_evspy \
+	__attribute__((used, section("host_evspy"), aligned(sizeof(void*)))) = { _func, _type, #_func }
+
+int event_notify(enum event_t type, void* data, int size);
+
+#endif // __HOST_EVENT_H__
@@ -0,0 +1,10 @@
+#ifndef __HOST_FDT_SUPPORT_H__
+#define __HOST_FDT_SUPPORT_H__
+
+#include <linux/libfdt.h>
+
+/* Host trees grow on demand, see <linux/libfdt.h> */
+int fdt_increase_size(void* fdt, int add_len);
+int fdt_find_or_add_subnode(void* fdt, int parentoffset, const char* name);
+
+#endif // __HOST_FDT_SUPPORT_H__
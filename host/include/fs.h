@@ -0,0 +1,11 @@
+#ifndef __HOST_FS_H__
+#define __HOST_FS_H__
+
+#include <common.h>
+#include <blk.h>
+
+int fs_set_blk_dev_with_part(struct blk_desc* desc, int part);
+int fs_read(const char* filename, ulong addr, loff_t offset, loff_t len, loff_t* actread);
+void fs_close(void);
+
+#endif // __HOST_FS_H__
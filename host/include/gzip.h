@@ -0,0 +1,8 @@
+#ifndef __HOST_GZIP_H__
+#define __HOST_GZIP_H__
+
+/* U-Boot gzip()/gunzip() on top of host zlib */
+int gunzip(void* dst, int dstlen, unsigned char* src, unsigned long* lenp);
+int gzip(void* dst, unsigned long* lenp, unsigned char* src, unsigned long srclen);
+
+#endif // __HOST_GZIP_H__
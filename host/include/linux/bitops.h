@@ -0,0 +1,6 @@
+#ifndef __HOST_LINUX_BITOPS_H__
+#define __HOST_LINUX_BITOPS_H__
+
+#define hweight8(w) __builtin_popcount((unsigned char) (w))
+
+#endif // __HOST_LINUX_BITOPS_H__
@@ -0,0 +1,13 @@
+/* IS_ENABLED() as in U-Boot <linux/kconfig.h>, options are set with -DCONFIG_...=1 */
+#ifndef __HOST_LINUX_KCONFIG_H__
+#define __HOST_LINUX_KCONFIG_H__
+
+#define __ARG_PLACEHOLDER_1 0,
+#define __take_second_arg(__ignored, val, ...) val
+#define ____is_defined(arg1_or_junk) __take_second_arg(arg1_or_junk 1, 0)
+#define ___is_defined(val) ____is_defined(__ARG_PLACEHOLDER_##val)
+#define __is_defined(x) ___is_defined(x)
+#define IS_ENABLED(option) __is_defined(option)
+#define CONFIG_IS_ENABLED(option) IS_ENABLED(CONFIG_##option)
+
+#endif // __HOST_LINUX_KCONFIG_H__
@@ -0,0 +1,13 @@
+#ifndef __HOST_LINUX_KERNEL_H__
+#define __HOST_LINUX_KERNEL_H__
+
+#include <limits.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define ALIGN(x, a) (((x) + ((__typeof__(x)) (a) - 1)) & ~((__typeof__(x)) (a) - 1))
+#define min(x, y) ({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); _x < _y ? _x : _y; })
+#define max(x, y) ({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); _x > _y ? _x : _y; })
+#define min_t(type, x, y) ({ type _x = (x); type _y = (y); _x < _y ? _x : _y; })
+#define max_t(type, x, y) ({ type _x = (x); type _y = (y); _x > _y ? _x : _y; })
+
+#endif // __HOST_LINUX_KERNEL_H__
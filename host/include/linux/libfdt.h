@@ -0,0 +1,42 @@
+#ifndef __HOST_LINUX_LIBFDT_H__
+#define __HOST_LINUX_LIBFDT_H__
+
+#include <stdint.h>
+
+/*
+ * Stand-in for libfdt. A blob is a struct host_fdt, which records nodes
+ * and properties, enough for the /chosen fixups of this repo and for
+ * tests reading them back. Node 0 is the root node.
+ */
+#define FDT_ERR_NOTFOUND 1
+#define FDT_ERR_NOSPACE 3
+
+#define HOST_FDT_MAX 32
+
+struct host_fdt_prop {
+	int node;
+	char name[32];
+	void *data;
+	int len;
+};
+
+struct host_fdt {
+	int nodes;
+	int parent[HOST_FDT_MAX];
+	char name[HOST_FDT_MAX][32];
+	int props;
+	struct host_fdt_prop prop[HOST_FDT_MAX];
+};
+
+void host_fdt_init(struct host_fdt* fdt);
+void host_fdt_free(struct host_fdt* fdt);
+
+int fdt_subnode_offset(const void* fdt, int parentoffset, const char* name);
+const void *fdt_getprop(const void* fdt, int nodeoffset, const char* name, int* lenp);
+int fdt_setprop(void* fdt, int nodeoffset, const char* name, const void* val, int len);
+int fdt_setprop_u32(void* fdt, int nodeoffset, const char* name, uint32_t val);
+int fdt_setprop_u64(void* fdt, int nodeoffset, const char* name, uint64_t val);
+int fdt_setprop_string(void* fdt, int nodeoffset, const char* name, const char* str);
+const char *fdt_strerror(int errval);
+
+#endif // __HOST_LINUX_LIBFDT_H__
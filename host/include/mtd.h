@@ -0,0 +1,94 @@
+#ifndef __HOST_MTD_H__
+#define __HOST_MTD_H__
+
+#include <common.h>
+
+/*
+ * RAM backed MTD with NOR semantics: erase sets bytes to 0xff, programming
+ * can only clear bits. Devices are created with host_mtd_add(). With
+ * host_mtd_set_timing() reads, programs and erases advance host_mtd_time_ns
+ * by SPI-NOR latencies, erases are counted per erase block.
+ */
+#define MTD_BIT_WRITEABLE 0x800
+
+struct mtd_info {
+	const char *name;
+	uint64_t size;
+	uint32_t erasesize;
+	uint32_t writesize;
+	uint32_t flags;
+	int index;
+	/* Host only */
+	uint8_t *data;
+	int pointable; /* mtd_point() succeeds, as on memory mapped NOR */
+	const struct host_mtd_timing *timing; /* NULL if not simulated */
+	uint32_t *erase_count; /* Erases per erase block */
+	uint32_t read_fault; /* Flip a bit in the n-th following read, 0 for none */
+};
+
+/* Latencies of a SPI-NOR, a program or read can't cross a page */
+struct host_mtd_timing {
+	uint32_t page_size;
+	uint64_t read_page_ns;
+	uint64_t program_page_ns;
+	uint64_t erase_block_ns;
+};
+
+/* Simulated flash busy time of all devices with timing */
+extern uint64_t host_mtd_time_ns;
+
+/* Bytes programmed and erased on all devices */
+extern uint64_t host_mtd_program_bytes;
+extern uint64_t host_mtd_erase_bytes;
+
+struct erase_info {
+	struct mtd_info *mtd;
+	uint64_t addr;
+	uint64_t len;
+};
+
+int mtd_read(struct mtd_info* mtd, loff_t from, size_t len, size_t* retlen, u_char* buf);
+int mtd_write(struct mtd_info* mtd, loff_t to, size_t len, size_t* retlen, const u_char* buf);
+int mtd_erase(struct mtd_info* mtd, struct erase_info* instr);
+int mtd_point(struct mtd_info* mtd, loff_t from, size_t len, size_t* retlen, void** virt, resource_size_t* phys);
+int mtd_unpoint(struct mtd_info* mtd, loff_t from, size_t len);
+int mtd_probe_devices(void);
+struct mtd_info *__mtd_next_device(int i);
+
+static inline int mtd_is_partition(const struct mtd_info* mtd)
+{
+	return 1;
+}
+
+#define mtd_for_each_device(mtd) \
+	for ((mtd) = __mtd_next_device(0); (mtd) != NULL; (mtd) = __mtd_next_device((mtd)->index + 1))
+
+/**
+ * host_mtd_add() - create an erased RAM backed MTD device
+ *
+ * @name: Partition name, such as "system_a"
+ * @size: Size, multiple of erasesize
+ * @erasesize: Erase block size
+ * @writesize: Program unit
+ * @return device, NULL on error
+ */
+struct mtd_info *host_mtd_add(const char* name, uint64_t size, uint32_t erasesize, uint32_t writesize);
+
+/**
+ * host_mtd_set_timing() - simulate latencies of a device
+ *
+ * Pages touched by a read or program and erase blocks erased add their
+ * latency to host_mtd_time_ns. Memory mapped reads through mtd_point()
+ * are not accounted.
+ *
+ * @mtd: Device
+ * @timing: Latencies, NULL to stop simulating
+ */
+void host_mtd_set_timing(struct mtd_info* mtd, const struct host_mtd_timing* timing);
+
+/**
+ * host_mtd_remove_all() - free all devices created by host_mtd_add()
+ */
+void host_mtd_remove_all(void);
+
+#endif // __HOST_MTD_H__
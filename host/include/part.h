@@ -0,0 +1,18 @@
+#ifndef __HOST_PART_H__
+#define __HOST_PART_H__
+
+#include <blk.h>
+
+struct disk_partition {
+	lbaint_t start;
+	lbaint_t size;
+	ulong blksz;
+	char name[32];
+	char uuid[37];
+};
+
+struct blk_desc *blk_get_dev(const char* ifname, int dev);
+int part_get_info(struct blk_desc* dev_desc, int part, struct disk_partition* info);
+int part_get_info_by_name(struct blk_desc* dev_desc, const char* name, struct disk_partition* info);
+
+#endif // __HOST_PART_H__
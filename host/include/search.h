@@ -0,0 +1,15 @@
+#ifndef __HOST_SEARCH_H__
+#define __HOST_SEARCH_H__
+
+#include <stddef.h>
+
+#define H_NOCLEAR (1 << 0)
+
+struct hsearch_data {
+	int unused;
+};
+
+int himport_r(struct hsearch_data* htab, const char* env, size_t size, const char sep,
+		int flag, int crlf_is_lf, int nvars, char* const vars[]);
+
+#endif // __HOST_SEARCH_H__
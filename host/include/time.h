@@ -0,0 +1,10 @@
+#ifndef __HOST_TIME_H__
+#define __HOST_TIME_H__
+
+#include_next <time.h>
+#include <stdint.h>
+
+/* Monotonic clock, or simulated flash time when a simulated MTD is used */
+uint64_t timer_get_us(void);
+
+#endif // __HOST_TIME_H__
@@ -0,0 +1,7 @@
+/* U-Boot crc32() is zlib crc32() */
+#ifndef __HOST_U_BOOT_CRC_H__
+#define __HOST_U_BOOT_CRC_H__
+
+#include <zlib.h>
+
+#endif // __HOST_U_BOOT_CRC_H__
@@ -0,0 +1,148 @@
+/*
+ * RAM backed MTD devices, see include/mtd.h.
+ */
+#include <common.h>
+#include <mtd.h>
+
+#define HOST_MTD_MAX 8
+
+static struct mtd_info *devices[HOST_MTD_MAX];
+uint64_t host_mtd_time_ns;
+uint64_t host_mtd_program_bytes;
+uint64_t host_mtd_erase_bytes;
+
+struct mtd_info *host_mtd_add(const char* name, uint64_t size, uint32_t erasesize, uint32_t writesize)
+{
+	if (!erasesize || !writesize || size % erasesize || erasesize % writesize)
+		return NULL;
+	for (int i = 0; i < HOST_MTD_MAX; ++i) {
+		if (devices[i])
+			continue;
+		struct mtd_info *mtd = calloc(1, sizeof(struct mtd_info));
+		if (!mtd)
+			return NULL;
+		mtd->data = malloc(size);
+		mtd->erase_count = calloc(size / erasesize, sizeof(uint32_t));
+		if (!mtd->data || !mtd->erase_count) {
+			free(mtd->data);
+			free(mtd->erase_count);
+			free(mtd);
+			return NULL;
+		}
+		memset(mtd->data, 0xff, size);
+		mtd->name = name;
+		mtd->size = size;
+		mtd->erasesize = erasesize;
+		mtd->writesize = writesize;
+		mtd->flags = MTD_BIT_WRITEABLE;
+		mtd->index = i;
+		devices[i] = mtd;
+		return mtd;
+	}
+	return NULL;
+}
+
+void host_mtd_remove_all(void)
+{
+	for (int i = 0; i < HOST_MTD_MAX; ++i) {
+		if (!devices[i])
+			continue;
+		free(devices[i]->data);
+		free(devices[i]->erase_count);
+		free(devices[i]);
+		devices[i] = NULL;
+	}
+}
+
+struct mtd_info *__mtd_next_device(int i)
+{
+	for (; i < HOST_MTD_MAX; ++i) {
+		if (devices[i])
+			return devices[i];
+	}
+	return NULL;
+}
+
+int mtd_probe_devices(void)
+{
+	return 0;
+}
+
+void host_mtd_set_timing(struct mtd_info* mtd, const struct host_mtd_timing* timing)
+{
+	mtd->timing = timing;
+}
+
+/* Pages touched by len bytes at offset */
+static uint64_t pages(const struct mtd_info* mtd, loff_t offset, size_t len)
+{
+	if (!len)
+		return 0;
+	const uint32_t page = mtd->timing->page_size;
+	return (offset + len + page - 1) / page - offset / page;
+}
+
+static int out_of_range(struct mtd_info* mtd, loff_t offset, size_t len)
+{
+	return offset < 0 || (uint64_t) offset > mtd->size || len > mtd->size - offset;
+}
+
+int mtd_read(struct mtd_info* mtd, loff_t from, size_t len, size_t* retlen, u_char* buf)
+{
+	*retlen = 0;
+	if (out_of_range(mtd, from, len))
+		return -EINVAL;
+	memcpy(buf, mtd->data + from, len);
+	if (mtd->read_fault && !--mtd->read_fault && len)
+		buf[len - 1] ^= 1;
+	if (mtd->timing)
+		host_mtd_time_ns += pages(mtd, from, len) * mtd->timing->read_page_ns;
+	*retlen = len;
+	return 0;
+}
+
+int mtd_write(struct mtd_info* mtd, loff_t to, size_t len, size_t* retlen, const u_char* buf)
+{
+	*retlen = 0;
+	if (out_of_range(mtd, to, len) || to % mtd->writesize)
+		return -EINVAL;
+	for (size_t i = 0; i < len; ++i)
+		mtd->data[to + i] &= buf[i];
+	host_mtd_program_bytes += len;
+	if (mtd->timing)
+		host_mtd_time_ns += pages(mtd, to, len) * mtd->timing->program_page_ns;
+	*retlen = len;
+	return 0;
+}
+
+int mtd_erase(struct mtd_info* mtd, struct erase_info* instr)
+{
+	if (out_of_range(mtd, instr->addr, instr->len) || instr->addr % mtd->erasesize || instr->len % mtd->erasesize)
+		return -EINVAL;
+	memset(mtd->data + instr->addr, 0xff, instr->len);
+	host_mtd_erase_bytes += instr->len;
+	for (uint64_t addr = instr->addr; addr < instr->addr + instr->len; addr += mtd->erasesize) {
+		mtd->erase_count[addr / mtd->erasesize]++;
+		if (mtd->timing)
+			host_mtd_time_ns += mtd->timing->erase_block_ns;
+	}
+	return 0;
+}
+
+int mtd_point(struct mtd_info* mtd, loff_t from, size_t len, size_t* retlen, void** virt, resource_size_t* phys)
+{
+	*retlen = 0;
+	if (!mtd->pointable)
+		return -EOPNOTSUPP;
+	if (out_of_range(mtd, from, len))
+		return -EINVAL;
+	*virt = mtd->data + from;
+	*phys = 0;
+	*retlen = len;
+	return 0;
+}
+
+int mtd_unpoint(struct mtd_info* mtd, loff_t from, size_t len)
+{
+	return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * nvram_root_swap() of system_boot.c on simulated SPI-NOR sections. Each
+ * scenario presets the swap variables in flash and boots, nvram is loaded
+ * and the new swap state committed as on target. Flash time of the boot
+ * is simulated with typical and maximum datasheet latencies and erases
+ * are counted per erase block for wear.
+ * Built as sim_boot_log and sim_boot_counter with CONFIG_DR_NVRAM_LOG and
+ * CONFIG_DR_NVRAM_BOOT_COUNTER to compare the commit strategies.
+ */
+#include "../nvram.c"
+#include "../system_boot.c"
+
+#define SECTION_SIZE (64 * 1024)
+#define ERASESIZE 4096
+#define WRITESIZE 1
+/* Variables besides the swap ones, as a typical product list */
+#define OTHER_VARS 40
+#define ENDURANCE 100000
+
+/* W25Q128JV class NOR, 256 byte page read at 50 MHz single SPI */
+static const struct host_mtd_timing nor_typ = {
+	.page_size = 256,
+	.read_page_ns = 42000,
+	.program_page_ns = 400000,
+	.erase_block_ns = 45000000,
+};
+
+static const struct host_mtd_timing nor_max = {
+	.page_size = 256,
+	.read_page_ns = 42000,
+	.program_page_ns = 3000000,
+	.erase_block_ns = 400000000,
+};
+
+struct scenario {
+	const char *name;
+	const char *part;
+	const char *swap;
+	ulong attempts; /* SYS_BOOT_ATTEMPTS, 0 if not set */
+	int boots;
+};
+
+static const struct scenario scenarios[] = {
+	{ "normal", "rootfs1", "rootfs1", 0, 1 },
+	{ "swap-init", "rootfs1", "rootfs2", 0, 1 },
+	{ "swap-ongoing", "rootfs1", "rootfs2", 1, 1 },
+	{ "swap-failed", "rootfs1", "rootfs2", 3, 1 },
+	{ "rollback", "rootfs1", "rootfs1", 3, 1 },
+	/* init, two attempts, failed and rollback */
+	{ "failed-update", "rootfs1", "rootfs2", 0, 5 },
+};
+
+static const char *state_str[] = {
+	[SWAP_NORMAL] = "normal",
+	[SWAP_INIT] = "swap-init",
+	[SWAP_ONGOING] = "swap-ongoing",
+	[SWAP_FAILED] = "swap-failed",
+	[SWAP_ROLLBACK] = "rollback",
+	[SWAP_INVAL] = "invalid",
+};
+
+struct result {
+	uint64_t typ_us;
+	uint64_t max_us;
+	struct nvram_io io;
+	uint32_t erases; /* Erase blocks erased, all devices */
+	uint32_t hot_erases; /* Erases of most erased block */
+	enum swap_state next; /* State found by the following boot */
+	const char *label;
+};
+
+/* Only flash is timed, CPU time of the simulated boot is not */
+uint64_t timer_get_us(void)
+{
+	return host_mtd_time_ns / 1000;
+}
+
+/* Loading and booting the image is not simulated */
+struct blk_desc *blk_get_dev(const char* ifname, int dev)
+{
+	return NULL;
+}
+
+int part_get_info(struct blk_desc* dev_desc, int part, struct disk_partition* info)
+{
+	return -ENOENT;
+}
+
+int part_get_info_by_name(struct blk_desc* dev_desc, const char* name, struct disk_partition* info)
+{
+	return -1;
+}
+
+int fs_set_blk_dev_with_part(struct blk_desc* desc, int part)
+{
+	return -ENODEV;
+}
+
+int fs_read(const char* filename, ulong addr, loff_t offset, loff_t len, loff_t* actread)
+{
+	return -ENOENT;
+}
+
+void fs_close(void)
+{
+}
+
+int do_bootm(struct cmd_tbl* cmdtp, int flag, int argc, char* const argv[])
+{
+	return CMD_RET_FAILURE;
+}
+
+/* Power cycle, nothing is kept but flash */
+static void reboot(void)
+{
+	nvram_release();
+#if IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)
+	memset(&counter, 0, sizeof(counter));
+#endif
+}
+
+static void fail(const char* what)
+{
+	printf("sim: failed %s\n", what);
+	exit(1);
+}
+
+/* Both sections written, the standby one with an older list */
+static void install(const struct scenario* s, const struct host_mtd_timing* timing)
+{
+	char name[24];
+	char value[32];
+
+	reboot();
+	host_mtd_remove_all();
+	struct mtd_info *a = host_mtd_add("system_a", SECTION_SIZE, ERASESIZE, WRITESIZE);
+	struct mtd_info *b = host_mtd_add("system_b", SECTION_SIZE, ERASESIZE, WRITESIZE);
+	if (!a || !b)
+		fail("adding sections");
+	host_mtd_set_timing(a, timing);
+	host_mtd_set_timing(b, timing);
+#if IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)
+	struct mtd_info *c = host_mtd_add(CONFIG_DR_NVRAM_BOOT_COUNTER_PART, ERASESIZE, ERASESIZE, WRITESIZE);
+	if (!c)
+		fail("adding boot counter");
+	host_mtd_set_timing(c, timing);
+#endif
+
+	for (int i = 0; i < OTHER_VARS; ++i) {
+		snprintf(name, sizeof(name), "SYS_PRODUCT_%02d", i);
+		snprintf(value, sizeof(value), "value-%08x", i * 2654435761u);
+		if (nvram_set(name, value))
+			fail("setting variables");
+	}
+	if (nvram_compact())
+		fail("committing variables");
+	if (nvram_set(sys_boot_part, s->part) || nvram_set(sys_boot_swap, s->swap))
+		fail("setting swap variables");
+	if (s->attempts && nvram_set_ulong(sys_boot_attempts, IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER) ? 1 : s->attempts))
+		fail("setting attempts");
+	if (nvram_compact())
+		fail("committing swap variables");
+#if IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)
+	if (nvram_counter_reset())
+		fail("resetting boot counter");
+	for (ulong i = 0; i < s->attempts; ++i) {
+		if (nvram_counter_inc())
+			fail("incrementing boot counter");
+	}
+#endif
+}
+
+static void run(const struct scenario* s, const struct host_mtd_timing* timing, struct result* res)
+{
+	printf("sim: %s, %s latencies\n", s->name, timing == &nor_typ ? "typical" : "maximum");
+	install(s, timing);
+	for (struct mtd_info *mtd = __mtd_next_device(0); mtd; mtd = __mtd_next_device(mtd->index + 1))
+		memset(mtd->erase_count, 0, mtd->size / mtd->erasesize * sizeof(uint32_t));
+	memset(&io, 0, sizeof(io));
+	host_mtd_time_ns = 0;
+
+	for (int i = 0; i < s->boots; ++i) {
+		reboot();
+		char *label = NULL;
+		const int r = nvram_root_swap(&label);
+		if (r)
+			fail("root swap");
+		/* Label points into the list, gone with the next boot */
+		if (!label || (strcmp(label, s->part) && strcmp(label, s->swap)))
+			fail("root swap label");
+		res->label = strcmp(label, s->swap) ? s->part : s->swap;
+	}
+	if (timing == &nor_typ)
+		res->typ_us = host_mtd_time_ns / 1000;
+	else
+		res->max_us = host_mtd_time_ns / 1000;
+	res->io = io;
+	res->erases = 0;
+	res->hot_erases = 0;
+	for (struct mtd_info *mtd = __mtd_next_device(0); mtd; mtd = __mtd_next_device(mtd->index + 1)) {
+		for (uint64_t i = 0; i < mtd->size / mtd->erasesize; ++i) {
+			res->erases += mtd->erase_count[i];
+			res->hot_erases = max(res->hot_erases, mtd->erase_count[i]);
+		}
+	}
+
+	/* State the next boot finds, the commit must have reached flash */
+	reboot();
+	ulong attempts = ULONG_MAX;
+	res->next = find_state(&attempts);
+}
+
+int main(int argc, char* argv[])
+{
+	struct result results[ARRAY_SIZE(scenarios)] = {};
+
+	for (size_t i = 0; i < ARRAY_SIZE(scenarios); ++i) {
+		run(&scenarios[i], &nor_typ, &results[i]);
+		run(&scenarios[i], &nor_max, &results[i]);
+	}
+
+	printf("\n%s commits, %d KiB sections, %d byte erase blocks, %d byte pages\n",
+		IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER) ? "boot counter" : IS_ENABLED(CONFIG_DR_NVRAM_LOG) ? "log" : "image",
+		SECTION_SIZE / 1024, ERASESIZE, nor_typ.page_size);
+	printf("%-14s %5s %8s %10s %10s %9s %9s %7s %7s %11s %-13s\n", "scenario", "boots", "root",
+		"typ-us", "max-us", "read", "program", "erases", "hot-blk", "boots-worn", "next");
+	for (size_t i = 0; i < ARRAY_SIZE(scenarios); ++i) {
+		const struct scenario *s = &scenarios[i];
+		const struct result *res = &results[i];
+		char worn[24] = "-";
+		/* Boots of this scenario until the most erased block reaches endurance */
+		if (res->hot_erases)
+			snprintf(worn, sizeof(worn), "%" PRIu64, (uint64_t) ENDURANCE * s->boots / res->hot_erases);
+		printf("%-14s %5d %8s %10" PRIu64 " %10" PRIu64 " %9" PRIu64 " %9" PRIu64 " %7" PRIu32 " %7" PRIu32 " %11s %-13s\n",
+			s->name, s->boots, res->label, res->typ_us, res->max_us, res->io.read_bytes,
+			res->io.program_bytes, res->erases, res->hot_erases, worn, state_str[res->next]);
+	}
+
+	reboot();
+	host_mtd_remove_all();
+	return 0;
+}
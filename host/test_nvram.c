@@ -0,0 +1,203 @@
+/*
+ * Set, commit, reload, corrupt and reload again on RAM backed MTD
+ * sections, read through mtd_read() and mapped with mtd_point(). nvram.c
+ * is built into this program to reach the loaded sections.
+ * Built once per commit strategy: test_nvram_log replays log records,
+ * test_nvram_gzip stores a compressed list, test_nvram_stream loads through
+ * the bounce buffer with a read fault on the second pass,
+ * test_nvram_pre_erase erases standby on the first change and
+ * test_nvram_fdt passes the list and boot stage timings to the OS through
+ * EVT_FT_FIXUP and test_nvram_deferred only writes on that event.
+ */
+#include "../nvram.c"
+
+#define SECTION_SIZE (16 * 1024)
+#define ERASESIZE 4096
+#define WRITESIZE 1
+
+static const char *variant =
+	IS_ENABLED(CONFIG_DR_NVRAM_LOG) ? "log" :
+	IS_ENABLED(CONFIG_DR_NVRAM_COMPRESS) ? "gzip" :
+	IS_ENABLED(CONFIG_DR_NVRAM_STREAMING) ? "stream" :
+	IS_ENABLED(CONFIG_DR_NVRAM_PRE_ERASE) ? "pre-erase" :
+	IS_ENABLED(CONFIG_DR_NVRAM_FDT) ? "fdt" :
+	IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT) ? "deferred" : "default";
+
+static int mapped;
+static int failed;
+
+static void expect(int ok, const char* what)
+{
+	if (ok)
+		return;
+	printf("FAIL: %s%s: %s\n", variant, mapped ? " mapped" : "", what);
+	failed++;
+}
+
+static int equal(const char* value, const char* expected)
+{
+	if (!value || !expected)
+		return value == expected;
+	return !strcmp(value, expected);
+}
+
+/* Values of SYS_TEST_A, _B and _C, NULL if not set */
+static void expect_vars(const char* what, const char* a, const char* b, const char* c)
+{
+	expect(equal(nvram_get("SYS_TEST_A"), a) && equal(nvram_get("SYS_TEST_B"), b)
+		&& equal(nvram_get("SYS_TEST_C"), c), what);
+}
+
+static void reload(const char* what)
+{
+	nvram_release();
+	expect(!nvram_init(), what);
+}
+
+static void make_flash(void)
+{
+	nvram_release();
+	host_mtd_remove_all();
+	if (!host_mtd_add("system_a", SECTION_SIZE, ERASESIZE, WRITESIZE)
+		|| !host_mtd_add("system_b", SECTION_SIZE, ERASESIZE, WRITESIZE)) {
+		printf("test: no memory for flash\n");
+		exit(1);
+	}
+	for (struct mtd_info *mtd = __mtd_next_device(0); mtd; mtd = __mtd_next_device(mtd->index + 1))
+		mtd->pointable = mapped;
+}
+
+/* Flip a bit in the last byte written to the active section */
+static void corrupt_active(void)
+{
+	struct nvram_part *part = active_part();
+	expect(part != NULL, "active section to corrupt");
+	if (!part)
+		return;
+	const size_t end = IS_ENABLED(CONFIG_DR_NVRAM_LOG) ? nvram->log_end : nvram->image_len;
+	part->mtd->data[end - 1] ^= 1;
+}
+
+/* Committed list in /chosen as on bootm, image must validate as in flash */
+static void test_fdt(void)
+{
+	struct host_fdt fdt;
+	host_fdt_init(&fdt);
+	struct event_ft_fixup fixup = { .tree = oftree_from_fdt(&fdt) };
+	expect(!event_notify(EVT_FT_FIXUP, &fixup, sizeof(fixup)), "devicetree fixup");
+
+	const int chosen = fdt_subnode_offset(&fdt, 0, "chosen");
+	int len = 0;
+	const uint8_t *image = fdt_getprop(&fdt, chosen, "dr,nvram", &len);
+	struct libnvram_header hdr;
+	const uint32_t hdr_len = libnvram_header_len();
+	expect(image && len > hdr_len && !libnvram_validate_header(image, len, &hdr)
+		&& hdr.len == len - hdr_len && dr_crc32(0, image + hdr_len, hdr.len) == hdr.crc32,
+		"list passed in /chosen");
+	const char *active = fdt_getprop(&fdt, chosen, "dr,nvram-active", NULL);
+	expect(active && !strcmp(active, active_str(nvram->trans.active)), "active section passed in /chosen");
+
+	if (IS_ENABLED(CONFIG_DR_BOOTSTAGE)) {
+		const int stages = fdt_subnode_offset(&fdt, chosen, "dr,bootstage");
+		const int init = fdt_subnode_offset(&fdt, stages, "nvram-init");
+		expect(stages >= 0 && init >= 0 && fdt_getprop(&fdt, init, "time-us", NULL)
+			&& fdt_getprop(&fdt, init, "count", NULL), "boot stages passed in /chosen");
+	}
+	host_fdt_free(&fdt);
+}
+
+/* Deferred commit writes nothing until the devicetree fixup on boot */
+static int commit(void)
+{
+	if (!IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT))
+		return nvram_commit();
+
+	const uint64_t programmed = host_mtd_program_bytes;
+	int r = nvram_commit();
+	expect(host_mtd_program_bytes == programmed, "deferred commit writes nothing");
+	if (!r) {
+		struct host_fdt fdt;
+		host_fdt_init(&fdt);
+		struct event_ft_fixup fixup = { .tree = oftree_from_fdt(&fdt) };
+		r = event_notify(EVT_FT_FIXUP, &fixup, sizeof(fixup));
+		host_fdt_free(&fdt);
+	}
+	return r;
+}
+
+static void run(void)
+{
+	const char *gen1[] = { "SYS_TEST_A", "1", "SYS_TEST_B", "1" };
+	const char *invalid[] = { "SYS_TEST_A", "3", "TEST_B", "3" };
+
+	make_flash();
+	reload("init on blank flash");
+	expect_vars("blank flash", NULL, NULL, NULL);
+
+	/* Batch is all or none */
+	expect(nvram_set_batch(invalid, 2) != 0, "batch with invalid name rejected");
+	expect_vars("rejected batch", NULL, NULL, NULL);
+	expect(!nvram_set_batch(gen1, 2), "batch set");
+	expect(!commit(), "commit first generation");
+
+	uint64_t erased = host_mtd_erase_bytes;
+	expect(!nvram_set("SYS_TEST_A", "2"), "set");
+	if (IS_ENABLED(CONFIG_DR_NVRAM_PRE_ERASE))
+		expect(host_mtd_erase_bytes > erased, "standby erased on first change");
+	expect(!nvram_set("SYS_TEST_B", NULL), "remove");
+	expect(!nvram_set("SYS_TEST_C", "2"), "set new");
+	erased = host_mtd_erase_bytes;
+	expect(!commit(), "commit second generation");
+	if (IS_ENABLED(CONFIG_DR_NVRAM_PRE_ERASE))
+		expect(host_mtd_erase_bytes == erased, "commit after pre-erase only programs");
+	reload("reload");
+	expect_vars("reloaded", "2", NULL, "2");
+	if (IS_ENABLED(CONFIG_DR_NVRAM_FDT))
+		test_fdt();
+
+	/* Rejected batch leaves list and flash untouched */
+	const uint64_t programmed = host_mtd_program_bytes;
+	expect(nvram_set_batch(invalid, 2) != 0, "batch with invalid name rejected after load");
+	expect(!commit(), "commit without changes");
+	expect(host_mtd_program_bytes == programmed, "nothing written for rejected batch");
+	expect_vars("rejected batch after load", "2", NULL, "2");
+
+	/* Log mode drops the corrupt record, A/B falls back to the other section */
+	corrupt_active();
+	reload("reload with corrupt active section");
+	expect_vars("previous generation", "1", "1", NULL);
+
+	expect(!nvram_set("SYS_TEST_C", "3"), "set after recovery");
+	expect(!commit(), "commit after recovery");
+	reload("reload after recovery");
+	expect_vars("committed after recovery", "1", "1", "3");
+
+	/* Section valid on first pass, corrupt when read again for parsing */
+	if (IS_ENABLED(CONFIG_DR_NVRAM_STREAMING)) {
+		active_part()->mtd->read_fault = 3;
+		reload("reload with read fault");
+		expect_vars("other section after read fault", "1", "1", NULL);
+	}
+
+	/* Nothing valid left, starts from an empty list */
+	for (struct mtd_info *mtd = __mtd_next_device(0); mtd; mtd = __mtd_next_device(mtd->index + 1))
+		mtd->data[libnvram_header_len()] ^= 1;
+	reload("reload with both sections corrupt");
+	expect_vars("both sections corrupt", NULL, NULL, NULL);
+	expect(!nvram_set("SYS_TEST_A", "4"), "set on empty list");
+	expect(!commit(), "commit on empty list");
+	reload("reload after rewrite");
+	expect_vars("rewritten", "4", NULL, NULL);
+
+	nvram_release();
+}
+
+int main(void)
+{
+	for (mapped = 0; mapped < 2; ++mapped)
+		run();
+	host_mtd_remove_all();
+
+	printf("nvram %s: %s\n", variant, failed ? "FAILED" : "OK");
+	return failed ? 1 : 0;
+}
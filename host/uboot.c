@@ -0,0 +1,108 @@
+/*
+ * Host implementations of the U-Boot functions used by the sources of
+ * this repo, see include/.
+ */
+#include <common.h>
+#include <time.h>
+#include <env.h>
+#include <env_internal.h>
+#include <bloblist.h>
+#include <gzip.h>
+#include <dm.h>
+#include <zlib.h>
+
+int host_verbose;
+struct hsearch_data env_htab;
+
+ulong simple_strtoul(const char* cp, char** endp, unsigned int base)
+{
+	return strtoul(cp, endp, base);
+}
+
+char *simple_itoa(ulong value)
+{
+	static char buf[24];
+	snprintf(buf, sizeof(buf), "%lu", value);
+	return buf;
+}
+
+const char *errno_str(int err)
+{
+	return strerror(err < 0 ? -err : err);
+}
+
+__attribute__((weak)) uint64_t timer_get_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int env_set(const char* varname, const char* value)
+{
+	return 0;
+}
+
+int himport_r(struct hsearch_data* htab, const char* env, size_t size, const char sep,
+		int flag, int crlf_is_lf, int nvars, char* const vars[])
+{
+	return 1;
+}
+
+void *bloblist_find(unsigned int tag, int size)
+{
+	return NULL;
+}
+
+/* gzip format, as U-Boot lib/gzip.c and lib/gunzip.c */
+int gzip(void* dst, unsigned long* lenp, unsigned char* src, unsigned long srclen)
+{
+	z_stream s = {};
+	if (deflateInit2(&s, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return -1;
+	s.next_in = src;
+	s.avail_in = srclen;
+	s.next_out = dst;
+	s.avail_out = *lenp;
+	const int r = deflate(&s, Z_FINISH);
+	*lenp = s.total_out;
+	deflateEnd(&s);
+	return r == Z_STREAM_END ? 0 : -1;
+}
+
+int gunzip(void* dst, int dstlen, unsigned char* src, unsigned long* lenp)
+{
+	z_stream s = {};
+	if (inflateInit2(&s, 16 + MAX_WBITS) != Z_OK)
+		return -1;
+	s.next_in = src;
+	s.avail_in = *lenp;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+	const int r = inflate(&s, Z_FINISH);
+	*lenp = s.total_out;
+	inflateEnd(&s);
+	return r == Z_STREAM_END ? 0 : -1;
+}
+
+ofnode ofnode_path(const char* path)
+{
+	ofnode node = { -1 };
+	return node;
+}
+
+int ofnode_parse_phandle_with_args(ofnode node, const char* list_name, const char* cells_name,
+				int cell_count, int index, struct ofnode_phandle_args* out_args)
+{
+	return -ENOENT;
+}
+
+int uclass_get_device_by_ofnode(enum uclass_id id, ofnode node, struct udevice** devp)
+{
+	return -ENODEV;
+}
+
+int uclass_get_device_by_name(enum uclass_id id, const char* name, struct udevice** devp)
+{
+	return -ENODEV;
+}
@@ -3,36 +3,1051 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <mtd.h>
+#include <dm.h>
+#include <blk.h>
+#include <part.h>
 #include <inttypes.h>
 #include <linux/ctype.h>
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <bloblist.h>
+#include <gzip.h>
+#include <env_internal.h>
+#include <search.h>
+#include <time.h>
+#include <event.h>
+#include <fdt_support.h>
+#include <linux/libfdt.h>
 #include "nvram.h"
+#include "nvram_handoff.h"
+#include "dr_crc32.h"
+#include "dr_bootstage.h"
 #include "libnvram/libnvram.h"
 
+/*
+ * Open addressing hash index over the entries of nvram->list.
+ * List order is left untouched, the index only speeds up lookups.
+ */
+struct nvram_index {
+	struct libnvram_entry **slots;
+	uint32_t size; /* power of two */
+	uint32_t used; /* live entries and tombstones */
+};
+
+#define INDEX_MIN_SIZE 16
+#define INDEX_TOMBSTONE ((struct libnvram_entry*) 1)
+
+/*
+ * Bump allocator backing list nodes and key/value copies.
+ * Nothing is freed individually, the whole arena is released at once when
+ * the list is rebuilt after commit or on init failure.
+ */
+struct nvram_arena_block {
+	struct nvram_arena_block *next;
+	size_t size;
+	size_t pos;
+	uint8_t data[];
+};
+
+struct nvram_arena {
+	struct nvram_arena_block *head;
+	size_t used;
+	size_t high_water;
+	uint32_t blocks; /* Blocks allocated since init */
+};
+
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN sizeof(void*)
+
+/*
+ * List node and entry in one allocation.
+ * Nodes deserialized from nvram->section point into it, nodes added by
+ * nvram_set() carry key and value inline after the node.
+ * Updated values are copied on write to arena storage.
+ */
+struct nvram_node {
+	struct libnvram_list list;
+	struct libnvram_entry entry;
+};
+
+/* Key changed since last commit, allocated from arena */
+struct nvram_dirty {
+	struct nvram_dirty *next;
+	uint32_t key_len;
+	uint8_t key[];
+};
+
+/*
+ * With CONFIG_DR_NVRAM_LOG, commits append records after the libnvram image
+ * of the active section until it's full:
+ * [magic:le32][len:le32][crc32:le32][payload]
+ * Payload uses the list entry layout, a zero value_len deletes the key.
+ * Records start writesize aligned and replay stops at the first invalid one.
+ */
+#define LOG_MAGIC 0x474f4c4e /* "NLOG" */
+#define LOG_HDR_LEN (3 * sizeof(uint32_t))
+
+/*
+ * Storage of one section, an MTD partition or a range of blocks on a block
+ * device with CONFIG_DR_NVRAM_BLK. Transaction logic only goes through
+ * part_read() and write_section(), erase and mapping are MTD only.
+ */
+struct nvram_part {
+	const char *name;
+	uint64_t size;
+	struct mtd_info *mtd;
+	struct blk_desc *blk;
+	int hwpart;
+	lbaint_t blk_start;
+};
+
 struct nvram {
-	struct mtd_info* system_a;
-	struct mtd_info* system_b;
+	struct nvram_part part_a;
+	struct nvram_part part_b;
+	struct nvram_part* system_a;
+	struct nvram_part* system_b;
 	struct libnvram_transaction trans;
+	/* Active section, backing storage for deserialized entries */
+	uint8_t *section;
+	size_t section_len;
+	int section_owned; /* section allocated by us */
+	int mapped; /* sections pointed to with mtd_point() */
+	size_t image_len; /* Length of active image in flash */
 	struct libnvram_list *list;
+	struct libnvram_list **list_tail;
+	struct nvram_index index;
+	struct nvram_arena arena;
+	struct nvram_dirty *dirty;
+	size_t log_end; /* Offset of next log record in active section */
+	int standby_erased;
 	int list_updated;
+	ulong init_us; /* Duration of load and deserialize */
+	ulong commit_us; /* Duration of last commit writing flash */
+};
+
+static struct nvram* nvram = NULL;
+
+/* Key resolved by nvram_lookup(), caches lookup until key set or list rebuilt */
+struct nvram_key {
+	struct nvram_key *next;
+	uint32_t generation; /* list_generation of cache, 0 if invalid */
+	char *value; /* printable value, NULL if not set */
+	int ulong_cached;
+	int ulong_base;
+	ulong ulong_value;
+	uint32_t key_len;
+	char key[];
+};
+
+static struct nvram_key* keys = NULL;
+/* Bumped when list is destroyed and all entry pointers become stale */
+static uint32_t list_generation = 1;
+
+/*
+ * Flash traffic since boot, boot counter included. Kept across nvram
+ * reloads, as wear and bus time are what commit changes are judged by.
+ */
+struct nvram_io {
+	uint64_t read_bytes;
+	uint64_t program_bytes;
+	uint64_t erase_bytes;
+	uint32_t erase_ops;
+	uint32_t erase_skipped; /* Blank erase blocks not erased */
 };
 
-static struct nvram* nvram = NULL;
+static struct nvram_io io;
+
+/* Ensure size bytes can be allocated without a new block */
+static int arena_reserve(struct nvram_arena* arena, size_t size)
+{
+	struct nvram_arena_block *block = arena->head;
+	if (block && block->size - block->pos >= size)
+		return 0;
+	const size_t block_size = max((size_t) ARENA_BLOCK_SIZE, size);
+	block = malloc(sizeof(struct nvram_arena_block) + block_size);
+	if (!block)
+		return -ENOMEM;
+	block->size = block_size;
+	block->pos = 0;
+	block->next = arena->head;
+	arena->head = block;
+	arena->blocks++;
+	return 0;
+}
+
+static void* arena_alloc(struct nvram_arena* arena, size_t size)
+{
+	size = ALIGN(size, ARENA_ALIGN);
+	if (arena_reserve(arena, size))
+		return NULL;
+	struct nvram_arena_block *block = arena->head;
+	void *ptr = block->data + block->pos;
+	block->pos += size;
+	arena->used += size;
+	if (arena->used > arena->high_water)
+		arena->high_water = arena->used;
+	return ptr;
+}
+
+static void arena_reset(struct nvram_arena* arena)
+{
+	struct nvram_arena_block *block = arena->head;
+	while (block) {
+		struct nvram_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->head = NULL;
+	arena->used = 0;
+}
+
+/* FNV-1a */
+static uint32_t hash_key(const uint8_t* key, uint32_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < len; ++i) {
+		hash ^= key[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int is_key_equal(const struct libnvram_entry* entry, const uint8_t* key, uint32_t len)
+{
+	return entry->key_len == len && !memcmp(entry->key, key, len);
+}
+
+/* Returns slot holding key, or -1 if not found */
+static int index_find(const struct nvram_index* index, const uint8_t* key, uint32_t len)
+{
+	const uint32_t mask = index->size - 1;
+	for (uint32_t i = hash_key(key, len) & mask, n = 0; n < index->size; i = (i + 1) & mask, ++n) {
+		struct libnvram_entry *entry = index->slots[i];
+		if (!entry)
+			return -1;
+		if (entry != INDEX_TOMBSTONE && is_key_equal(entry, key, len))
+			return i;
+	}
+	return -1;
+}
+
+static void index_insert(struct nvram_index* index, struct libnvram_entry* entry)
+{
+	const uint32_t mask = index->size - 1;
+	int tombstone = -1;
+	uint32_t i = hash_key(entry->key, entry->key_len) & mask;
+	for (uint32_t n = 0; n < index->size; i = (i + 1) & mask, ++n) {
+		struct libnvram_entry *cur = index->slots[i];
+		if (!cur)
+			break;
+		if (cur == INDEX_TOMBSTONE) {
+			if (tombstone < 0)
+				tombstone = i;
+		}
+		else
+		if (is_key_equal(cur, entry->key, entry->key_len)) {
+			index->slots[i] = entry;
+			return;
+		}
+	}
+	if (tombstone >= 0) {
+		index->slots[tombstone] = entry;
+		return;
+	}
+	index->slots[i] = entry;
+	index->used++;
+}
+
+static void index_remove(struct nvram_index* index, const uint8_t* key, uint32_t len)
+{
+	if (!index->slots)
+		return;
+	const int slot = index_find(index, key, len);
+	if (slot >= 0)
+		index->slots[slot] = INDEX_TOMBSTONE;
+}
+
+static void index_destroy(struct nvram_index* index)
+{
+	if (index->slots)
+		free(index->slots);
+	memset(index, 0, sizeof(struct nvram_index));
+}
+
+/*
+ * (Re)build index from list, sized for a load factor below 1/2.
+ * On allocation failure the index is left empty and lookups fall back to
+ * walking the list.
+ */
+static int index_build(struct nvram_index* index, struct libnvram_list* list, uint32_t extra)
+{
+	uint32_t count = extra;
+	for (struct libnvram_list *cur = list; cur; cur = cur->next)
+		count++;
+	uint32_t size = INDEX_MIN_SIZE;
+	while (size < count * 2)
+		size <<= 1;
+
+	index_destroy(index);
+	index->slots = calloc(size, sizeof(struct libnvram_entry*));
+	if (!index->slots)
+		return -ENOMEM;
+	index->size = size;
+	for (struct libnvram_list *cur = list; cur; cur = cur->next)
+		index_insert(index, cur->entry);
+
+	return 0;
+}
+
+static struct libnvram_entry* list_get(const uint8_t* key, uint32_t len)
+{
+	if (!nvram->index.slots)
+		return libnvram_list_get(nvram->list, key, len);
+	const int slot = index_find(&nvram->index, key, len);
+	return slot < 0 ? NULL : nvram->index.slots[slot];
+}
+
+static void list_destroy(void)
+{
+	if (++list_generation == 0)
+		list_generation = 1;
+	nvram->dirty = NULL;
+	nvram->list = NULL;
+	nvram->list_tail = &nvram->list;
+	index_destroy(&nvram->index);
+	arena_reset(&nvram->arena);
+}
+
+static void list_append(struct nvram_node* node)
+{
+	node->list.entry = &node->entry;
+	node->list.next = NULL;
+	*nvram->list_tail = &node->list;
+	nvram->list_tail = &node->list.next;
+}
+
+/*
+ * Copy live entries into a fresh arena and release the old one, dropping
+ * values replaced by nvram_set() and nodes of removed keys. Used where the
+ * list can't be rebuilt from a retained image. On failure the list is left
+ * as it was.
+ */
+static int list_compact(void)
+{
+	struct nvram_arena old = nvram->arena;
+	struct libnvram_list *list = nvram->list;
+	struct libnvram_list **list_tail = nvram->list_tail;
+	int r = 0;
+
+	nvram->arena.head = NULL;
+	nvram->arena.used = 0;
+	nvram->list = NULL;
+	nvram->list_tail = &nvram->list;
+	for (struct libnvram_list *cur = list; cur; cur = cur->next) {
+		const struct libnvram_entry *entry = cur->entry;
+		struct nvram_node *node = arena_alloc(&nvram->arena, sizeof(struct nvram_node) + entry->key_len + entry->value_len);
+		if (!node) {
+			r = -ENOMEM;
+			break;
+		}
+		node->entry.key = (uint8_t*) (node + 1);
+		node->entry.key_len = entry->key_len;
+		node->entry.value = node->entry.key + entry->key_len;
+		node->entry.value_len = entry->value_len;
+		memcpy(node->entry.key, entry->key, entry->key_len);
+		memcpy(node->entry.value, entry->value, entry->value_len);
+		list_append(node);
+	}
+	if (r) {
+		const size_t high_water = max(old.high_water, nvram->arena.high_water);
+		const uint32_t blocks = nvram->arena.blocks;
+		arena_reset(&nvram->arena);
+		nvram->arena = old;
+		nvram->arena.high_water = high_water;
+		nvram->arena.blocks = blocks;
+		nvram->list = list;
+		nvram->list_tail = list_tail;
+		return r;
+	}
+
+	arena_reset(&old);
+	if (++list_generation == 0)
+		list_generation = 1;
+	nvram->dirty = NULL;
+	if (index_build(&nvram->index, nvram->list, 0))
+		pr_err("nvram: no memory for index, falling back to list lookup\n");
+	return 0;
+}
+
+static void keys_invalidate(const uint8_t* key, uint32_t len)
+{
+	for (struct nvram_key *cur = keys; cur; cur = cur->next) {
+		if (cur->key_len == len && !memcmp(cur->key, key, len))
+			cur->generation = 0;
+	}
+}
+
+static int list_set(const struct libnvram_entry* entry)
+{
+	keys_invalidate(entry->key, entry->key_len);
+	struct libnvram_entry *cur = list_get(entry->key, entry->key_len);
+	if (cur) {
+		/* Copy on write, section buffer is never modified */
+		uint8_t *value = arena_alloc(&nvram->arena, entry->value_len);
+		if (!value)
+			return -ENOMEM;
+		memcpy(value, entry->value, entry->value_len);
+		cur->value = value;
+		cur->value_len = entry->value_len;
+		return 0;
+	}
+
+	struct nvram_node *node = arena_alloc(&nvram->arena, sizeof(struct nvram_node) + entry->key_len + entry->value_len);
+	if (!node)
+		return -ENOMEM;
+	node->entry.key = (uint8_t*) (node + 1);
+	node->entry.key_len = entry->key_len;
+	node->entry.value = node->entry.key + entry->key_len;
+	node->entry.value_len = entry->value_len;
+	memcpy(node->entry.key, entry->key, entry->key_len);
+	memcpy(node->entry.value, entry->value, entry->value_len);
+	list_append(node);
+
+	if (!nvram->index.slots)
+		return 0;
+	/* Keep load factor below 3/4, tombstones included */
+	if ((nvram->index.used + 1) * 4 > nvram->index.size * 3)
+		index_build(&nvram->index, nvram->list, 0);
+	else
+		index_insert(&nvram->index, &node->entry);
+	return 0;
+}
+
+static int list_remove(const uint8_t* key, uint32_t len)
+{
+	keys_invalidate(key, len);
+	index_remove(&nvram->index, key, len);
+	for (struct libnvram_list **cur = &nvram->list; *cur; cur = &(*cur)->next) {
+		if (is_key_equal((*cur)->entry, key, len)) {
+			struct libnvram_list *node = *cur;
+			*cur = node->next;
+			if (nvram->list_tail == &node->next)
+				nvram->list_tail = cur;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static uint32_t letou32(const uint8_t* le)
+{
+	return (uint32_t) le[3] << 24 | le[2] << 16 | le[1] << 8 | le[0];
+}
+
+static void u32tole(uint32_t value, uint8_t* le)
+{
+	le[0] = value & 0xff;
+	le[1] = (value >> 8) & 0xff;
+	le[2] = (value >> 16) & 0xff;
+	le[3] = (value >> 24) & 0xff;
+}
+
+/*
+ * Parse entry at *pos of a list payload and advance *pos past it.
+ * Payload is a sequence of [key_len:le32][value_len:le32][key][value].
+ */
+static int parse_entry(uint8_t* data, uint32_t size, uint32_t* pos, struct libnvram_entry* entry)
+{
+	uint32_t cur = *pos;
+	if (size - cur < 2 * sizeof(uint32_t))
+		return -EINVAL;
+	const uint32_t key_len = letou32(data + cur);
+	const uint32_t value_len = letou32(data + cur + sizeof(uint32_t));
+	cur += 2 * sizeof(uint32_t);
+	if (!key_len || key_len > size - cur || value_len > size - cur - key_len)
+		return -EINVAL;
+
+	entry->key = data + cur;
+	entry->key_len = key_len;
+	entry->value = data + cur + key_len;
+	entry->value_len = value_len;
+	*pos = cur + key_len + value_len;
+	return 0;
+}
+
+static int deserialize_payload(uint8_t* data, uint32_t len)
+{
+	uint32_t pos = 0;
+	while (pos < len) {
+		struct nvram_node *node = arena_alloc(&nvram->arena, sizeof(struct nvram_node));
+		if (!node)
+			return -ENOMEM;
+		const int r = parse_entry(data, len, &pos, &node->entry);
+		if (r)
+			return r;
+		list_append(node);
+	}
+
+	return 0;
+}
+
+/*
+ * Compressed list is stored as a single entry, value holds uncompressed
+ * payload length followed by gzip'd LIBNVRAM_TYPE_LIST payload.
+ * Lists holding it are unpacked on every load, whether or not
+ * CONFIG_DR_NVRAM_COMPRESS is set, so a board that turns compression off
+ * can still read what it committed before.
+ */
+static const uint8_t compress_key[] = "__NVRAM_GZIP";
+
+/* Payload is unpacked into the arena, entries point there */
+static int decompress(const struct libnvram_entry* entry)
+{
+	if (entry->value_len < sizeof(uint32_t))
+		return -EINVAL;
+	const uint32_t raw_len = letou32(entry->value);
+	uint8_t *raw = arena_alloc(&nvram->arena, raw_len);
+	if (!raw)
+		return -ENOMEM;
+	unsigned long len = entry->value_len - sizeof(uint32_t);
+	if (gunzip(raw, raw_len, entry->value + sizeof(uint32_t), &len) || len != raw_len) {
+		pr_err("nvram: failed decompressing list\n");
+		return -EINVAL;
+	}
+	return deserialize_payload(raw, raw_len);
+}
+
+/*
+ * Replace a packed entry in the list by the entries it holds.
+ * We only ever write it as the sole entry. Plain entries next to it come
+ * from a writer without compression support, such as Linux libnvram,
+ * that set them on top of the packed list it read. They are newer and
+ * override packed values of the same key.
+ */
+static int unpack_list(void)
+{
+	struct libnvram_list *packed = NULL;
+	for (struct libnvram_list **cur = &nvram->list; *cur; cur = &(*cur)->next) {
+		if (is_key_equal((*cur)->entry, compress_key, sizeof(compress_key))) {
+			packed = *cur;
+			*cur = packed->next;
+			if (nvram->list_tail == &packed->next)
+				nvram->list_tail = cur;
+			break;
+		}
+	}
+	if (!packed)
+		return 0;
+
+	struct libnvram_list *plain = nvram->list;
+	nvram->list = NULL;
+	nvram->list_tail = &nvram->list;
+	int r = decompress(packed->entry);
+	if (r || !plain)
+		return r;
+
+	uint32_t count = 0;
+	for (struct libnvram_list *cur = plain; cur; cur = cur->next, ++count) {
+		r = list_set(cur->entry);
+		if (r)
+			return r;
+	}
+	pr_err("nvram: %" PRIu32 " plain entries stored next to compressed list, merged over it\n", count);
+	/* Write back merged so the mix doesn't persist */
+	nvram->list_updated = 1;
+	return 0;
+}
+
+/* Pack list into a single entry, fails unless it saves space */
+static int compress_list(struct libnvram_entry* entry)
+{
+	if (!nvram->list)
+		return -EINVAL;
+
+	const uint32_t hdr_len = libnvram_header_len();
+	const uint32_t size = libnvram_serialize_size(nvram->list, LIBNVRAM_TYPE_LIST);
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	int r = -ENOMEM;
+	uint8_t *raw = malloc(size);
+	uint8_t *packed = malloc(size);
+	if (!raw || !packed)
+		goto exit;
+	if (!libnvram_serialize(nvram->list, raw, size, &hdr))
+		goto exit;
+
+	/* Output larger than the plain list fails, nothing to gain */
+	unsigned long len = size - sizeof(uint32_t);
+	if (gzip(packed + sizeof(uint32_t), &len, raw + hdr_len, size - hdr_len)) {
+		r = -EFBIG;
+		goto exit;
+	}
+	const uint32_t value_len = len + sizeof(uint32_t);
+	if (2 * sizeof(uint32_t) + sizeof(compress_key) + value_len >= size - hdr_len) {
+		r = -EFBIG;
+		goto exit;
+	}
+	u32tole(size - hdr_len, packed);
+	entry->key = (uint8_t*) compress_key;
+	entry->key_len = sizeof(compress_key);
+	entry->value = packed;
+	entry->value_len = value_len;
+	packed = NULL;
+	r = 0;
+
+exit:
+	if (raw)
+		free(raw);
+	if (packed)
+		free(packed);
+	return r;
+}
+
+/*
+ * Deserialize LIBNVRAM_TYPE_LIST payload without copying, entries point
+ * directly into data which must outlive the list.
+ */
+static int deserialize(uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
+{
+	if (hdr->type != LIBNVRAM_TYPE_LIST || hdr->len > len)
+		return -EINVAL;
+
+	const int r = deserialize_payload(data, hdr->len);
+	if (r)
+		return r;
+	return unpack_list();
+}
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_BLK)
+/* Block device holding both sections is shared, select hwpart per access */
+static int blk_select(struct nvram_part* part)
+{
+	const int r = blk_dselect_hwpart(part->blk, part->hwpart);
+	if (r)
+		pr_err("nvram: failed selecting hwpart %d: %d\n", part->hwpart, r);
+	return r;
+}
+
+static void blk_deselect(struct nvram_part* part)
+{
+	if (part->hwpart)
+		blk_dselect_hwpart(part->blk, 0);
+}
+
+/* Whole blocks go straight to buf, partial ones through a bounce block */
+static int blk_read_range(struct nvram_part* part, loff_t offset, size_t len, uint8_t* buf)
+{
+	const ulong blksz = part->blk->blksz;
+	uint8_t *bounce = NULL;
+	int r = 0;
+
+	while (len) {
+		const lbaint_t blk = part->blk_start + offset / blksz;
+		const size_t skip = offset % blksz;
+		if (!skip && len >= blksz) {
+			const lbaint_t count = len / blksz;
+			if (blk_dread(part->blk, blk, count, buf) != count) {
+				r = -EIO;
+				break;
+			}
+			offset += count * blksz;
+			buf += count * blksz;
+			len -= count * blksz;
+			continue;
+		}
+		if (!bounce && !(bounce = malloc(blksz))) {
+			r = -ENOMEM;
+			break;
+		}
+		if (blk_dread(part->blk, blk, 1, bounce) != 1) {
+			r = -EIO;
+			break;
+		}
+		const size_t n = min_t(size_t, len, blksz - skip);
+		memcpy(buf, bounce + skip, n);
+		offset += n;
+		buf += n;
+		len -= n;
+	}
+	if (bounce)
+		free(bounce);
+	return r;
+}
+
+/* Writes only the blocks covered by len, last one padded with 0xff */
+static int blk_write_range(struct nvram_part* part, const uint8_t* data, size_t len)
+{
+	const ulong blksz = part->blk->blksz;
+	const lbaint_t count = len / blksz;
+
+	if (count && blk_dwrite(part->blk, part->blk_start, count, data) != count)
+		return -EIO;
+	if (len % blksz) {
+		uint8_t *bounce = malloc(blksz);
+		if (!bounce)
+			return -ENOMEM;
+		memset(bounce, 0xff, blksz);
+		memcpy(bounce, data + count * blksz, len % blksz);
+		const ulong n = blk_dwrite(part->blk, part->blk_start + count, 1, bounce);
+		free(bounce);
+		if (n != 1)
+			return -EIO;
+	}
+	return 0;
+}
+#endif
+
+static int part_read(struct nvram_part* part, loff_t offset, size_t len, uint8_t* buf)
+{
+	size_t retlen = 0;
+	int r = 0;
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_BLK)
+	if (part->blk) {
+		r = blk_select(part);
+		if (!r)
+			r = blk_read_range(part, offset, len, buf);
+		blk_deselect(part);
+	}
+	else
+#endif
+	{
+		r = mtd_read(part->mtd, offset, len, &retlen, buf);
+		if (!r && retlen != len)
+			r = -EIO;
+	}
+	if (!r)
+		io.read_bytes += len;
+	if (r)
+		pr_err("nvram: failed reading %s: %d\n", part->name, r);
+	return r;
+}
+
+/*
+ * Read header first and only fetch the payload length it declares.
+ * Sections with an invalid header are returned header only, leaving it to
+ * libnvram_init_transaction() to mark them as such.
+ */
+static int read_section(struct nvram_part* part, uint8_t** data, size_t* len)
+{
+	const uint32_t hdr_len = libnvram_header_len();
+	struct libnvram_header hdr;
+	size_t size = hdr_len;
+
+	if (part->size < hdr_len) {
+		pr_err("nvram: %s smaller than header\n", part->name);
+		return -EINVAL;
+	}
+
+	uint8_t *buf = malloc(hdr_len);
+	if (!buf)
+		return -ENOMEM;
+
+	int r = part_read(part, 0, hdr_len, buf);
+	if (r)
+		goto error;
+
+	if (!libnvram_validate_header(buf, hdr_len, &hdr) && hdr.len <= part->size - hdr_len) {
+		uint8_t *tmp = realloc(buf, hdr_len + hdr.len);
+		if (!tmp) {
+			free(buf);
+			return -ENOMEM;
+		}
+		buf = tmp;
+		r = part_read(part, hdr_len, hdr.len, buf + hdr_len);
+		if (r)
+			goto error;
+		size += hdr.len;
+	}
+
+	*data = buf;
+	*len = size;
+
+	return 0;
+
+error:
+	free(buf);
+	return r;
+}
+
+#define BLANK_CHECK_CHUNK 256
+
+/* Sets *blank if range reads as erased (all 0xff) */
+static int is_blank(struct mtd_info* mtd, loff_t offset, size_t len, int* blank)
+{
+	uint8_t buf[BLANK_CHECK_CHUNK];
+	size_t retlen = 0;
+
+	*blank = 0;
+	while (len) {
+		const size_t chunk = min(len, sizeof(buf));
+		int r = mtd_read(mtd, offset, chunk, &retlen, buf);
+		io.read_bytes += retlen;
+		if (r != 0 || retlen != chunk) {
+			pr_err("nvram: failed reading %s: %d\n", mtd->name, r);
+			return r ? r : -EIO;
+		}
+		for (size_t i = 0; i < chunk; ++i) {
+			if (buf[i] != 0xff)
+				return 0;
+		}
+		offset += chunk;
+		len -= chunk;
+	}
+	*blank = 1;
+
+	return 0;
+}
+
+static int erase_range(struct mtd_info* mtd, loff_t offset, size_t len)
+{
+	struct erase_info erase_op = {};
+
+	erase_op.mtd = mtd;
+	erase_op.addr = offset;
+	erase_op.len = len;
+
+	int r = mtd_erase(mtd, &erase_op);
+	io.erase_ops++;
+	io.erase_bytes += len;
+	if (r != 0)
+		pr_err("nvram: failed erasing %s: %d\n", mtd->name, r);
+	return r;
+}
+
+/*
+ * Erase only the blocks covered by len, skipping blocks already blank.
+ * Consecutive dirty blocks are erased in a single operation.
+ */
+static int prepare_section(struct mtd_info* mtd, size_t len)
+{
+	const size_t erase_len = ALIGN(len, mtd->erasesize);
+	size_t dirty_start = 0;
+	size_t dirty_len = 0;
+	int r = 0;
+
+	for (size_t offset = 0; offset < erase_len; offset += mtd->erasesize) {
+		int blank = 0;
+		r = is_blank(mtd, offset, mtd->erasesize, &blank);
+		if (r)
+			return r;
+		if (!blank) {
+			if (!dirty_len)
+				dirty_start = offset;
+			dirty_len += mtd->erasesize;
+			continue;
+		}
+		io.erase_skipped++;
+		if (dirty_len) {
+			r = erase_range(mtd, dirty_start, dirty_len);
+			if (r)
+				return r;
+			dirty_len = 0;
+		}
+	}
+	if (dirty_len)
+		r = erase_range(mtd, dirty_start, dirty_len);
+
+	return r;
+}
+
+static int write_section(struct nvram_part* part, const uint8_t* data, size_t len)
+{
+	size_t retlen = 0;
+	int r = 0;
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_BLK)
+	if (part->blk) {
+		/* Nothing to erase, program only the blocks covered by len */
+		r = blk_select(part);
+		if (!r)
+			r = blk_write_range(part, data, len);
+		blk_deselect(part);
+		if (r)
+			pr_err("nvram: failed writing %s: %d\n", part->name, r);
+		else
+			io.program_bytes += ALIGN(len, part->blk->blksz);
+		return r;
+	}
+#endif
+
+	/* Log mode needs the space after the image erased for appending */
+	struct mtd_info *mtd = part->mtd;
+	r = prepare_section(mtd, IS_ENABLED(CONFIG_DR_NVRAM_LOG) ? mtd->size : len);
+	if (r)
+		return r;
+
+	r = mtd_write(mtd, 0, len, &retlen, data);
+	io.program_bytes += retlen;
+	if (r != 0 || retlen != len) {
+		pr_err("nvram: failed writing %s: %d\n", mtd->name, r);
+		return r;
+	}
+
+	return 0;
+}
+
+static struct nvram_part* active_part(void)
+{
+	if ((nvram->trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A)
+		return nvram->system_a;
+	if ((nvram->trans.active & LIBNVRAM_ACTIVE_B) == LIBNVRAM_ACTIVE_B)
+		return nvram->system_b;
+	return NULL;
+}
+
+static struct nvram_part* standby_part(void)
+{
+	if ((nvram->trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A)
+		return nvram->system_b;
+	if ((nvram->trans.active & LIBNVRAM_ACTIVE_B) == LIBNVRAM_ACTIVE_B)
+		return nvram->system_a;
+	return NULL;
+}
+
+static void mark_dirty(const uint8_t* key, uint32_t key_len)
+{
+	if (!IS_ENABLED(CONFIG_DR_NVRAM_LOG))
+		return;
+	for (struct nvram_dirty *cur = nvram->dirty; cur; cur = cur->next) {
+		if (cur->key_len == key_len && !memcmp(cur->key, key, key_len))
+			return;
+	}
+	struct nvram_dirty *dirty = arena_alloc(&nvram->arena, sizeof(struct nvram_dirty) + key_len);
+	if (!dirty) {
+		/* Change can't be tracked, force compaction on commit */
+		nvram->log_end = SIZE_MAX;
+		return;
+	}
+	dirty->key_len = key_len;
+	memcpy(dirty->key, key, key_len);
+	dirty->next = nvram->dirty;
+	nvram->dirty = dirty;
+}
+
+/* Validate whole record payload before applying anything */
+static int log_apply(uint8_t* payload, uint32_t len)
+{
+	struct libnvram_entry entry;
+	uint32_t pos = 0;
+	int r = 0;
+
+	while (pos < len) {
+		r = parse_entry(payload, len, &pos, &entry);
+		if (r)
+			return r;
+	}
+	pos = 0;
+	while (pos < len) {
+		parse_entry(payload, len, &pos, &entry);
+		if (entry.value_len)
+			r = list_set(&entry);
+		else
+			list_remove(entry.key, entry.key_len);
+		if (r)
+			return r;
+	}
 
-static int read_section(struct mtd_info* mtd, uint8_t** data, size_t* len)
+	return 0;
+}
+
+static int log_replay(struct mtd_info* mtd, size_t offset)
 {
+	uint8_t hdr[LOG_HDR_LEN];
 	size_t retlen = 0;
-	uint8_t *buf = malloc(mtd->size);
+	int r = 0;
+
+	while (offset < mtd->size && mtd->size - offset >= LOG_HDR_LEN) {
+		r = mtd_read(mtd, offset, LOG_HDR_LEN, &retlen, hdr);
+		io.read_bytes += retlen;
+		if (r != 0 || retlen != LOG_HDR_LEN)
+			break;
+		const uint32_t len = letou32(hdr + sizeof(uint32_t));
+		if (letou32(hdr) != LOG_MAGIC || len > mtd->size - offset - LOG_HDR_LEN)
+			break;
+
+		uint8_t *payload = malloc(len);
+		if (!payload)
+			return -ENOMEM;
+		r = mtd_read(mtd, offset + LOG_HDR_LEN, len, &retlen, payload);
+		io.read_bytes += retlen;
+		if (r != 0 || retlen != len || dr_crc32(0, payload, len) != letou32(hdr + 2 * sizeof(uint32_t))) {
+			free(payload);
+			break;
+		}
+		r = log_apply(payload, len);
+		free(payload);
+		if (r)
+			return r;
+		offset = ALIGN(offset + LOG_HDR_LEN + len, mtd->writesize);
+	}
+	if (r)
+		pr_err("nvram: failed reading log of %s: %d\n", mtd->name, r);
+	nvram->log_end = offset;
+
+	return 0;
+}
+
+/*
+ * Append keys changed since last commit as one record to the active section.
+ * Returns -ENOSPC if the record doesn't fit in erased space and the list
+ * needs compacting into the other section.
+ */
+static int log_append(void)
+{
+	struct mtd_info *mtd = active_part() ? active_part()->mtd : NULL;
+	if (!mtd || !nvram->dirty)
+		return -ENOSPC;
+
+	uint32_t len = 0;
+	for (struct nvram_dirty *cur = nvram->dirty; cur; cur = cur->next) {
+		const struct libnvram_entry *entry = list_get(cur->key, cur->key_len);
+		len += 2 * sizeof(uint32_t) + cur->key_len + (entry ? entry->value_len : 0);
+	}
+	const size_t rec_len = ALIGN(LOG_HDR_LEN + len, mtd->writesize);
+	if (nvram->log_end > mtd->size || rec_len > mtd->size - nvram->log_end)
+		return -ENOSPC;
+	int blank = 0;
+	int r = is_blank(mtd, nvram->log_end, rec_len, &blank);
+	if (r)
+		return r;
+	if (!blank)
+		return -ENOSPC;
+
+	uint8_t *buf = malloc(rec_len);
 	if (!buf)
 		return -ENOMEM;
+	memset(buf, 0xff, rec_len);
+	uint8_t *payload = buf + LOG_HDR_LEN;
+	uint32_t pos = 0;
+	for (struct nvram_dirty *cur = nvram->dirty; cur; cur = cur->next) {
+		const struct libnvram_entry *entry = list_get(cur->key, cur->key_len);
+		const uint32_t value_len = entry ? entry->value_len : 0;
+		u32tole(cur->key_len, payload + pos);
+		u32tole(value_len, payload + pos + sizeof(uint32_t));
+		pos += 2 * sizeof(uint32_t);
+		memcpy(payload + pos, cur->key, cur->key_len);
+		pos += cur->key_len;
+		if (value_len)
+			memcpy(payload + pos, entry->value, value_len);
+		pos += value_len;
+	}
+	u32tole(LOG_MAGIC, buf);
+	u32tole(len, buf + sizeof(uint32_t));
+	u32tole(dr_crc32(0, payload, len), buf + 2 * sizeof(uint32_t));
 
-	int r = mtd_read(mtd, 0, mtd->size, &retlen, buf);
-	if (r != 0 || retlen != mtd->size) {
-		free(buf);
-		pr_err("nvram: failed reading %s: %d\n", mtd->name, r);
-		return r;
+	size_t retlen = 0;
+	r = mtd_write(mtd, nvram->log_end, rec_len, &retlen, buf);
+	io.program_bytes += retlen;
+	free(buf);
+	if (r != 0 || retlen != rec_len) {
+		pr_err("nvram: failed writing log to %s: %d\n", mtd->name, r);
+		/* Partial record is never blank, next commit compacts */
+		return r ? r : -EIO;
 	}
-	*data = buf;
-	*len = mtd->size;
+	nvram->log_end += rec_len;
+	nvram->dirty = NULL;
 
 	return 0;
 }
@@ -59,128 +1074,606 @@ struct mtd_info* get_mtd_by_partname(const char* partname)
 	return NULL;
 }
 
-/**
- * nvram_init() - initialize nvram, must be called before any other functions
- *
- * @return 0 if ok, -errno on error
+static const struct libnvram_header* active_hdr(void)
+{
+	if ((nvram->trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A)
+		return &nvram->trans.section_a.hdr;
+	return &nvram->trans.section_b.hdr;
+}
+
+static int point_section(struct mtd_info* mtd, uint8_t** data)
+{
+	resource_size_t phys = 0;
+	size_t retlen = 0;
+	void *virt = NULL;
+
+	int r = mtd_point(mtd, 0, mtd->size, &retlen, &virt, &phys);
+	if (!r && retlen != mtd->size) {
+		mtd_unpoint(mtd, 0, retlen);
+		r = -EOPNOTSUPP;
+	}
+	if (!r)
+		*data = virt;
+	return r;
+}
+
+static void unmap_sections(void)
+{
+	if (!nvram->mapped)
+		return;
+	mtd_unpoint(nvram->system_a->mtd, 0, nvram->system_a->size);
+	mtd_unpoint(nvram->system_b->mtd, 0, nvram->system_b->size);
+	nvram->mapped = 0;
+}
+
+/* Validate and deserialize straight from memory mapped flash, no copy */
+static int load_mapped(void)
+{
+	uint8_t *map_a = NULL;
+	uint8_t *map_b = NULL;
+
+	if (!nvram->system_a->mtd || !nvram->system_b->mtd)
+		return -EOPNOTSUPP;
+	int r = point_section(nvram->system_a->mtd, &map_a);
+	if (r)
+		return r;
+	r = point_section(nvram->system_b->mtd, &map_b);
+	if (r) {
+		mtd_unpoint(nvram->system_a->mtd, 0, nvram->system_a->size);
+		return r;
+	}
+	nvram->mapped = 1;
+
+	libnvram_init_transaction(&nvram->trans, map_a, nvram->system_a->size, map_b, nvram->system_b->size);
+	struct nvram_part *part = active_part();
+	if (part) {
+		nvram->section = part == nvram->system_a ? map_a : map_b;
+		nvram->section_len = part->size;
+		nvram->section_owned = 0;
+		nvram->image_len = libnvram_header_len() + active_hdr()->len;
+	}
+	pr_info("nvram: using memory mapped sections\n");
+
+	return 0;
+}
+
+static void nvram_release(void)
+{
+	if (!nvram)
+		return;
+	list_destroy();
+	if (nvram->section && nvram->section_owned)
+		free(nvram->section);
+	unmap_sections();
+	free(nvram);
+	nvram = NULL;
+}
+
+/*
+ * Probe only the device holding the sections, given by phandle
+ * /chosen/dr,nvram-device or CONFIG_DR_NVRAM_MTD_DEVICE.
  */
-static int nvram_init(void)
+static int __maybe_unused probe_nvram_device(void)
 {
-	if (nvram)
+	struct ofnode_phandle_args args;
+	struct udevice *dev = NULL;
+	int r = -ENODEV;
+
+	if (!ofnode_parse_phandle_with_args(ofnode_path("/chosen"), "dr,nvram-device", NULL, 0, 0, &args)) {
+		r = uclass_get_device_by_ofnode(UCLASS_MTD, args.node, &dev);
+		if (r)
+			r = uclass_get_device_by_ofnode(UCLASS_SPI_FLASH, args.node, &dev);
+	}
+	else
+	if (strlen(CONFIG_DR_NVRAM_MTD_DEVICE)) {
+		r = uclass_get_device_by_name(UCLASS_MTD, CONFIG_DR_NVRAM_MTD_DEVICE, &dev);
+		if (r)
+			r = uclass_get_device_by_name(UCLASS_SPI_FLASH, CONFIG_DR_NVRAM_MTD_DEVICE, &dev);
+	}
+	return r;
+}
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_BLK)
+/*
+ * Sections in GPT partitions "system_a" and "system_b" of the user area,
+ * or at fixed offsets of a hardware partition such as eMMC boot0.
+ */
+static struct nvram_part* find_blk_part(struct nvram_part* part, struct blk_desc* dev,
+					const char* partname, ulong offset)
+{
+	memset(part, 0, sizeof(struct nvram_part));
+	part->name = partname;
+	part->blk = dev;
+	part->hwpart = CONFIG_DR_NVRAM_BLK_HWPART;
+	if (part->hwpart) {
+		if (offset % dev->blksz) {
+			pr_err("nvram: %s offset not block aligned\n", partname);
+			return NULL;
+		}
+		part->blk_start = offset / dev->blksz;
+		part->size = CONFIG_DR_NVRAM_BLK_SECTION_SIZE;
+		return part;
+	}
+
+	struct disk_partition info;
+	if (part_get_info_by_name(dev, partname, &info) < 1)
+		return NULL;
+	part->blk_start = info.start;
+	part->size = (uint64_t) info.size * info.blksz;
+	return part;
+}
+
+static int open_blk_sections(void)
+{
+	struct blk_desc *dev = blk_get_dev(CONFIG_DR_NVRAM_BLK_IFACE, CONFIG_DR_NVRAM_BLK_DEV);
+	if (!dev) {
+		pr_err("nvram: no block device %s %d\n", CONFIG_DR_NVRAM_BLK_IFACE, CONFIG_DR_NVRAM_BLK_DEV);
+		return -ENODEV;
+	}
+#if CONFIG_DR_NVRAM_BLK_HWPART
+	const ulong offset_a = CONFIG_DR_NVRAM_BLK_SYSTEM_A_OFFSET;
+	const ulong offset_b = CONFIG_DR_NVRAM_BLK_SYSTEM_B_OFFSET;
+#else
+	const ulong offset_a = 0;
+	const ulong offset_b = 0;
+#endif
+	nvram->system_a = find_blk_part(&nvram->part_a, dev, "system_a", offset_a);
+	nvram->system_b = find_blk_part(&nvram->part_b, dev, "system_b", offset_b);
+	return 0;
+}
+#else
+static struct nvram_part* find_mtd_part(struct nvram_part* part, const char* partname)
+{
+	struct mtd_info *mtd = get_mtd_by_partname(partname);
+	if (!mtd)
+		return NULL;
+	memset(part, 0, sizeof(struct nvram_part));
+	part->name = mtd->name;
+	part->size = mtd->size;
+	part->mtd = mtd;
+	return part;
+}
+
+static int find_sections(void)
+{
+	nvram->system_a = find_mtd_part(&nvram->part_a, "system_a");
+	nvram->system_b = find_mtd_part(&nvram->part_b, "system_b");
+	return nvram->system_a && nvram->system_b ? 0 : -ENODEV;
+}
+#endif
+
+/* Look up flash partitions, deferred until needed when loaded from handoff */
+static int open_sections(void)
+{
+	if (nvram->system_a && nvram->system_b)
 		return 0;
 
-	uint8_t *buf_a = NULL;
-	size_t buf_a_len = 0;
-	uint8_t *buf_b = NULL;
-	size_t buf_b_len = 0;
-	nvram = (struct nvram*) malloc(sizeof(struct nvram));
-	if (!nvram)
-		return -ENOMEM;
-	memset(nvram, 0, sizeof(struct nvram));
-	int r = 0;
+#if IS_ENABLED(CONFIG_DR_NVRAM_BLK)
+	const int r = open_blk_sections();
+	if (r)
+		return r;
+#else
+	if (!probe_nvram_device() && !find_sections())
+		return 0;
 
 	/* Ensure all devices (and their partitions) are probed */
 	mtd_probe_devices();
-	nvram->system_a = get_mtd_by_partname("system_a");
+	find_sections();
+#endif
 	if (nvram->system_a == NULL) {
 		pr_err("nvram: system_a partition not found\n");
-		r = -ENODEV;
-		goto exit;
+		return -ENODEV;
 	}
-	nvram->system_b = get_mtd_by_partname("system_b");
 	if (nvram->system_b == NULL) {
 		pr_err("nvram: system_b partition not found\n");
-		r = -ENODEV;
-		goto exit;
+		return -ENODEV;
 	}
+	return 0;
+}
 
-	r = read_section(nvram->system_a, &buf_a, &buf_a_len);
+/* Read both sections and keep the active one */
+static int load_sections(void)
+{
+	uint8_t *buf_a = NULL;
+	size_t buf_a_len = 0;
+	uint8_t *buf_b = NULL;
+	size_t buf_b_len = 0;
+
+	int r = open_sections();
 	if (r)
-		goto exit;
-	r = read_section(nvram->system_b, &buf_b, &buf_b_len);
+		return r;
+
+	if (!load_mapped())
+		return 0;
+
+	dr_bootstage_start(DR_BOOTSTAGE_NVRAM_READ);
+	r = read_section(nvram->system_a, &buf_a, &buf_a_len);
+	if (!r)
+		r = read_section(nvram->system_b, &buf_b, &buf_b_len);
+	dr_bootstage_end(DR_BOOTSTAGE_NVRAM_READ, buf_a_len + buf_b_len);
 	if (r)
 		goto exit;
 
 	libnvram_init_transaction(&nvram->trans, buf_a, buf_a_len, buf_b, buf_b_len);
-	pr_info("nvram: active: %s\n", active_str(nvram->trans.active));
 	if ((nvram->trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A) {
-		r = libnvram_deserialize(&nvram->list, buf_a + libnvram_header_len(), buf_a_len - libnvram_header_len(), &nvram->trans.section_a.hdr);
+		nvram->section = buf_a;
+		nvram->section_len = buf_a_len;
+		nvram->image_len = buf_a_len;
+		buf_a = NULL;
 	}
 	else
 	if ((nvram->trans.active & LIBNVRAM_ACTIVE_B) == LIBNVRAM_ACTIVE_B) {
-		r = libnvram_deserialize(&nvram->list, buf_b + libnvram_header_len(), buf_b_len - libnvram_header_len(), &nvram->trans.section_b.hdr);
-	}
-
-	if (r) {
-		pr_err("nvram: deserialize libnvram_error: %d\n", r);
-		r = -ENOMEM;
-		goto exit;
+		nvram->section = buf_b;
+		nvram->section_len = buf_b_len;
+		nvram->image_len = buf_b_len;
+		buf_b = NULL;
 	}
+	nvram->section_owned = 1;
 
-	r = 0;
 exit:
 	if (buf_a)
 		free(buf_a);
 	if (buf_b)
 		free(buf_b);
-	if (r) {
-		if (nvram) {
-			free(nvram);
-			nvram = NULL;
+	return r;
+}
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_STREAMING)
+/*
+ * Incremental deserializer for streamed payload, entries are copied to
+ * arena as their bytes arrive.
+ */
+struct stream_parser {
+	uint8_t lens[2 * sizeof(uint32_t)];
+	uint32_t lens_pos;
+	struct nvram_node *node;
+	uint8_t *dst;
+	uint32_t pending; /* bytes missing of current node key and value */
+	uint32_t left;    /* bytes left of payload */
+};
+
+static int stream_feed(struct stream_parser* p, const uint8_t* data, uint32_t len)
+{
+	p->left -= len;
+	while (len) {
+		if (!p->node) {
+			const uint32_t n = min(len, (uint32_t) sizeof(p->lens) - p->lens_pos);
+			memcpy(p->lens + p->lens_pos, data, n);
+			p->lens_pos += n;
+			data += n;
+			len -= n;
+			if (p->lens_pos < sizeof(p->lens))
+				continue;
+
+			const uint32_t key_len = letou32(p->lens);
+			const uint32_t value_len = letou32(p->lens + sizeof(uint32_t));
+			const uint32_t avail = p->left + len;
+			if (!key_len || key_len > avail || value_len > avail - key_len)
+				return -EINVAL;
+			p->node = arena_alloc(&nvram->arena, sizeof(struct nvram_node) + key_len + value_len);
+			if (!p->node)
+				return -ENOMEM;
+			p->node->entry.key = (uint8_t*) (p->node + 1);
+			p->node->entry.key_len = key_len;
+			p->node->entry.value = p->node->entry.key + key_len;
+			p->node->entry.value_len = value_len;
+			p->dst = p->node->entry.key;
+			p->pending = key_len + value_len;
+			p->lens_pos = 0;
+		}
+		const uint32_t n = min(len, p->pending);
+		memcpy(p->dst, data, n);
+		p->dst += n;
+		p->pending -= n;
+		data += n;
+		len -= n;
+		if (!p->pending) {
+			list_append(p->node);
+			p->node = NULL;
 		}
 	}
-	return r;
+	return 0;
 }
 
-static int write_section(struct mtd_info* mtd, const uint8_t* data, size_t len)
+/*
+ * Stream payload through bounce buffer, checking crc32 against header.
+ * Entries are deserialized on the fly if parser is given.
+ * Sets *valid if payload matches header.
+ */
+static int stream_section(struct nvram_part* part, const struct libnvram_header* hdr, uint8_t* bounce,
+				struct stream_parser* parser, int* valid)
 {
-	struct erase_info erase_op = {};
-	size_t retlen = 0;
+	const uint32_t hdr_len = libnvram_header_len();
+	uint32_t crc = 0;
 
-	erase_op.mtd = mtd;
-	erase_op.addr = 0;
-	erase_op.len = mtd->size;
+	*valid = 0;
+	if (hdr->len > part->size - hdr_len)
+		return 0;
+	for (uint32_t pos = 0; pos < hdr->len;) {
+		const uint32_t chunk = min(hdr->len - pos, (uint32_t) CONFIG_DR_NVRAM_STREAM_BUF_SIZE);
+		int r = part_read(part, hdr_len + pos, chunk, bounce);
+		if (r)
+			return r;
+		crc = dr_crc32(crc, bounce, chunk);
+		if (parser) {
+			r = stream_feed(parser, bounce, chunk);
+			if (r)
+				return r;
+		}
+		pos += chunk;
+	}
+	if (parser && (parser->node || parser->lens_pos))
+		return -EINVAL;
+	*valid = crc == hdr->crc32;
 
-	int r = mtd_erase(mtd, &erase_op);
-	if (r != 0) {
-		pr_err("nvram: failed erasing %s: %d\n", mtd->name, r);
+	return 0;
+}
+
+/*
+ * Validate header and payload of one section with bounded memory.
+ * Leaves a header-only image in stub for libnvram_init_transaction(),
+ * describing an empty payload if valid or failing validation otherwise.
+ */
+static int stream_validate(struct nvram_part* part, uint8_t* bounce, uint8_t* stub, struct libnvram_header* hdr)
+{
+	const uint32_t hdr_len = libnvram_header_len();
+	int valid = 0;
+
+	memset(stub, 0, hdr_len);
+	int r = part_read(part, 0, hdr_len, bounce);
+	if (r)
+		return r;
+	if (libnvram_validate_header(bounce, hdr_len, hdr))
+		return 0;
+	r = stream_section(part, hdr, bounce, NULL, &valid);
+	if (r || !valid)
 		return r;
-	}
 
-	r = mtd_write(mtd, 0, len, &retlen, data);
-	if (r != 0 || retlen != len) {
-		pr_err("nvram: failed writing %s: %d\n", mtd->name, r);
+	/* Only user counter and type matter for transaction state */
+	struct libnvram_header stub_hdr = *hdr;
+	if (!libnvram_serialize(NULL, stub, hdr_len, &stub_hdr))
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Load through fixed size bounce buffer instead of whole sections */
+static int load_streaming(void)
+{
+	const uint32_t hdr_len = libnvram_header_len();
+	struct libnvram_header hdr_a;
+	struct libnvram_header hdr_b;
+	uint8_t *stub_a = NULL;
+	uint8_t *stub_b = NULL;
+
+	int r = open_sections();
+	if (r)
 		return r;
+
+	uint8_t *bounce = malloc(max((uint32_t) CONFIG_DR_NVRAM_STREAM_BUF_SIZE, hdr_len));
+	stub_a = malloc(hdr_len);
+	stub_b = malloc(hdr_len);
+	if (!bounce || !stub_a || !stub_b) {
+		r = -ENOMEM;
+		goto exit;
 	}
 
+	r = stream_validate(nvram->system_a, bounce, stub_a, &hdr_a);
+	if (r)
+		goto exit;
+	r = stream_validate(nvram->system_b, bounce, stub_b, &hdr_b);
+	if (r)
+		goto exit;
+	libnvram_init_transaction(&nvram->trans, stub_a, hdr_len, stub_b, hdr_len);
+
+	/*
+	 * Payload is read again for deserializing. A section failing that
+	 * second pass is dropped as invalid, as load_sections() would have,
+	 * and the other one is tried.
+	 */
+	struct nvram_part *part = NULL;
+	const struct libnvram_header *hdr = NULL;
+	while ((part = active_part())) {
+		uint8_t *stub = part == nvram->system_a ? stub_a : stub_b;
+		struct stream_parser parser = {};
+		int valid = 0;
+		hdr = part == nvram->system_a ? &hdr_a : &hdr_b;
+		if (hdr->type != LIBNVRAM_TYPE_LIST) {
+			r = -EINVAL;
+			goto exit;
+		}
+		parser.left = hdr->len;
+		r = stream_section(part, hdr, bounce, &parser, &valid);
+		if (!r && valid)
+			break;
+		if (r == -ENOMEM) {
+			pr_err("nvram: failed streaming %s: %d\n", part->name, r);
+			goto exit;
+		}
+		pr_err("nvram: %s invalid on second read: %d\n", part->name, r ? r : -EIO);
+		list_destroy();
+		memset(stub, 0, hdr_len);
+		libnvram_init_transaction(&nvram->trans, stub_a, hdr_len, stub_b, hdr_len);
+		r = 0;
+	}
+	if (part) {
+		r = unpack_list();
+		if (r) {
+			pr_err("nvram: failed unpacking %s: %d\n", part->name, r);
+			goto exit;
+		}
+		nvram->image_len = hdr_len + hdr->len;
+	}
+
+exit:
+	if (bounce)
+		free(bounce);
+	if (stub_a)
+		free(stub_a);
+	if (stub_b)
+		free(stub_b);
+	return r;
+}
+
+#else
+static int load_streaming(void)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+/* Use section and transaction validated by SPL, flash is left untouched */
+static int load_handoff(void)
+{
+	struct nvram_handoff *handoff = bloblist_find(CONFIG_BLOBLIST_DR_NVRAM, 0);
+	if (!handoff)
+		return -ENOENT;
+
+	nvram->trans = handoff->trans;
+	if (nvram->trans.active != LIBNVRAM_ACTIVE_NONE && handoff->section_len >= libnvram_header_len()) {
+		nvram->section = handoff->section;
+		nvram->section_len = handoff->section_len;
+		nvram->image_len = handoff->section_len;
+		nvram->section_owned = 0;
+	}
+	pr_info("nvram: loaded from SPL handoff\n");
 	return 0;
 }
 
-int nvram_commit(void)
+/**
+ * nvram_init() - initialize nvram, must be called before any other functions
+ *
+ * @return 0 if ok, -errno on error
+ */
+static int nvram_init(void)
+{
+	if (nvram)
+		return 0;
+
+	const uint64_t start = timer_get_us();
+	nvram = (struct nvram*) malloc(sizeof(struct nvram));
+	if (!nvram)
+		return -ENOMEM;
+	dr_bootstage_start(DR_BOOTSTAGE_NVRAM_INIT);
+	memset(nvram, 0, sizeof(struct nvram));
+	nvram->list_tail = &nvram->list;
+	int r = -ENOENT;
+
+	if (IS_ENABLED(CONFIG_DR_NVRAM_HANDOFF))
+		r = load_handoff();
+	if (r)
+		r = IS_ENABLED(CONFIG_DR_NVRAM_STREAMING) ? load_streaming() : load_sections();
+	if (r)
+		goto exit;
+
+	pr_info("nvram: active: %s\n", active_str(nvram->trans.active));
+	/* Keep active section, entries are deserialized in place */
+	if (nvram->section) {
+		dr_bootstage_start(DR_BOOTSTAGE_NVRAM_DESERIALIZE);
+		r = deserialize(nvram->section + libnvram_header_len(), nvram->section_len - libnvram_header_len(), active_hdr());
+		dr_bootstage_end(DR_BOOTSTAGE_NVRAM_DESERIALIZE, nvram->image_len);
+		if (r) {
+			pr_err("nvram: deserialize failed: %d\n", r);
+			goto exit;
+		}
+	}
+
+	if (index_build(&nvram->index, nvram->list, 0))
+		pr_err("nvram: no memory for index, falling back to list lookup\n");
+
+	if (IS_ENABLED(CONFIG_DR_NVRAM_LOG) && active_part()) {
+		struct mtd_info *mtd = active_part()->mtd;
+		r = log_replay(mtd, ALIGN(nvram->image_len, mtd->writesize));
+		if (r)
+			goto exit;
+	}
+
+	nvram->init_us = timer_get_us() - start;
+	r = 0;
+exit:
+	dr_bootstage_end(DR_BOOTSTAGE_NVRAM_INIT, r ? 0 : nvram->image_len);
+	if (r)
+		nvram_release();
+	return r;
+}
+
+int nvram_prepare_standby(void)
+{
+	const int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return r;
+	}
+	if (open_sections())
+		return -ENODEV;
+	struct nvram_part *part = standby_part();
+	if (!part || !part->mtd || nvram->standby_erased)
+		return 0;
+	/* Interrupted erase is caught by the blank check in write_section() */
+	const int err = prepare_section(part->mtd, part->size);
+	if (!err)
+		nvram->standby_erased = 1;
+	return err;
+}
+
+/* Write changes, with compact set as a full image even in log mode */
+static int flush(int compact)
 {
 	if (!nvram)
 		return -ENXIO;
 	if (!nvram->list_updated)
 		return 0;
 
+	const uint64_t start = timer_get_us();
+	uint64_t written = 0;
 	uint8_t *buf = NULL;
-	int r = 0;
-	uint32_t size = libnvram_serialize_size(nvram->list, LIBNVRAM_TYPE_LIST);
+	int r = open_sections();
+	if (r)
+		return r;
+	dr_bootstage_start(DR_BOOTSTAGE_NVRAM_COMMIT);
+	if (IS_ENABLED(CONFIG_DR_NVRAM_LOG) && !compact) {
+		r = log_append();
+		if (!r) {
+			nvram->list_updated = 0;
+			dr_bootstage_end(DR_BOOTSTAGE_NVRAM_COMMIT, 0);
+			return 0;
+		}
+		if (r != -ENOSPC) {
+			dr_bootstage_end(DR_BOOTSTAGE_NVRAM_COMMIT, 0);
+			return r;
+		}
+		pr_info("nvram: log full, compacting\n");
+	}
+
+	struct libnvram_list *list = nvram->list;
+	struct libnvram_list packed;
+	struct libnvram_entry packed_entry;
+	packed_entry.value = NULL;
+	if (IS_ENABLED(CONFIG_DR_NVRAM_COMPRESS) && !compress_list(&packed_entry)) {
+		packed.entry = &packed_entry;
+		packed.next = NULL;
+		list = &packed;
+	}
+
+	uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
 	if (size > nvram->system_a->size || size > nvram->system_b->size) {
 		pr_err("nvram: serialied size does not fit in flash");
-		return -EFBIG;
+		r = -EFBIG;
+		goto exit;
 	}
 
+	/* Written image becomes the new backing section once committed */
 	buf = (uint8_t*) malloc(size);
 	if (!buf) {
 		pr_err("nvram: failed allocating %" PRIu32 " byte write buffer\n", size);
-		return -ENOMEM;
+		r = -ENOMEM;
+		goto exit;
 	}
 
 	struct libnvram_header hdr;
 	hdr.type = LIBNVRAM_TYPE_LIST;
 	enum libnvram_operation op = libnvram_next_transaction(&nvram->trans, &hdr);
-	if (!libnvram_serialize(nvram->list, buf, size, &hdr)) {
+	if (!libnvram_serialize(list, buf, size, &hdr)) {
 		pr_err("nvram: failed serialize\n");
 		r = -ENOMEM;
 		goto exit;
@@ -188,6 +1681,7 @@ int nvram_commit(void)
 
 	const int is_write_a = (op & LIBNVRAM_OPERATION_WRITE_A) == LIBNVRAM_OPERATION_WRITE_A;
 	const int is_counter_reset = (op & LIBNVRAM_OPERATION_COUNTER_RESET) == LIBNVRAM_OPERATION_COUNTER_RESET;
+	dr_bootstage_start(DR_BOOTSTAGE_NVRAM_WRITE);
 	// first write
 	if (is_write_a)
 		r = write_section(nvram->system_a, buf, size);
@@ -202,20 +1696,79 @@ int nvram_commit(void)
 			r = write_section(nvram->system_a, buf, size);
 		}
 	}
+	if (!r)
+		written = is_counter_reset ? 2 * size : size;
+	dr_bootstage_end(DR_BOOTSTAGE_NVRAM_WRITE, written);
 	if (r)
 		goto exit;
 
 	libnvram_update_transaction(&nvram->trans, op, &hdr);
+	nvram->commit_us = timer_get_us() - start;
 	pr_info("nvram: active: %s\n", active_str(nvram->trans.active));
 	nvram->list_updated = 0;
+	nvram->standby_erased = 0;
+	nvram->image_len = size;
+	if (IS_ENABLED(CONFIG_DR_NVRAM_LOG))
+		nvram->log_end = ALIGN(size, active_part()->mtd->writesize);
+
+	/*
+	 * Streaming keeps memory bounded by the list, don't retain image.
+	 * Compact the arena instead, or it grows with every set and commit.
+	 */
+	if (IS_ENABLED(CONFIG_DR_NVRAM_STREAMING)) {
+		nvram->dirty = NULL;
+		if (list_compact())
+			pr_err("nvram: no memory for compacting list, keeping old\n");
+		r = 0;
+		goto exit;
+	}
+
+	/* Release arena in one go by rebuilding list from the written image */
+	list_destroy();
+	if (nvram->section && nvram->section_owned)
+		free(nvram->section);
+	unmap_sections();
+	nvram->section = buf;
+	nvram->section_len = size;
+	nvram->section_owned = 1;
+	buf = NULL;
+	r = deserialize(nvram->section + libnvram_header_len(), nvram->section_len - libnvram_header_len(), &hdr);
+	if (!r && index_build(&nvram->index, nvram->list, 0))
+		pr_err("nvram: no memory for index, falling back to list lookup\n");
+	if (r) {
+		/* Flash is up to date, start over from there on next access */
+		pr_err("nvram: failed rebuilding list: %d\n", r);
+		nvram_release();
+	}
 
 	r = 0;
 exit:
+	dr_bootstage_end(DR_BOOTSTAGE_NVRAM_COMMIT, written);
 	if (buf)
 		free(buf);
+	if (packed_entry.value)
+		free(packed_entry.value);
 	return r;
 }
 
+int nvram_flush(void)
+{
+	return flush(0);
+}
+
+int nvram_compact(void)
+{
+	return flush(1);
+}
+
+/* Changes stay in list_updated until flushed before booting the OS */
+int nvram_commit(void)
+{
+	if (!IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT))
+		return nvram_flush();
+	return nvram ? 0 : -ENXIO;
+}
+
 static int is_printable_string(const uint8_t* buf, uint32_t size)
 {
 	if (strnlen((const char*) buf, size) != size - 1) {
@@ -240,7 +1793,7 @@ char *nvram_get(const char* varname)
 		return NULL;
 	}
 
-	struct libnvram_entry *entry = libnvram_list_get(nvram->list, (uint8_t*) varname, strlen(varname) + 1);
+	struct libnvram_entry *entry = list_get((uint8_t*) varname, strlen(varname) + 1);
 	if (entry && is_printable_string(entry->value, entry->value_len))
 		return (char*) entry->value;
 	// not entry->value not string
@@ -265,36 +1818,52 @@ static int starts_with(const char* str, const char* prefix)
 	return 0;
 }
 
-int nvram_set(const char* varname, const char* value)
+static const char *sys_prefix = "SYS_";
+
+static int validate_var(const char* var_prefix, const char* varname, const char* value)
 {
 	if (!varname)
 		return 1;
-
-	int r = nvram_init();
-	if (r) {
-		pr_err("nvram: init failed [%d]\n", r);
-		return 1;
-	}
-
 	if (!is_printable_string((uint8_t*) varname, strlen(varname) + 1)) {
 		pr_err("nvram: varname not printable\n");
 		return 1;
 	}
-	const char *var_prefix= "SYS_";
 	if (!starts_with(varname, var_prefix)) {
 		pr_err("nvram: varname not prefixed with %s\n", var_prefix);
 		return 1;
 	}
-	if (!value || !strlen(value)) {
-		if (libnvram_list_remove(&nvram->list, (uint8_t*) varname, strlen(varname) + 1)) {
-			nvram->list_updated = 1;
-		}
-		return 0;
-	}
-	if (!is_printable_string((uint8_t*) value, strlen(value) + 1)) {
+	if (value && strlen(value) && !is_printable_string((uint8_t*) value, strlen(value) + 1)) {
 		pr_err("nvram: value not printable\n");
 		return 1;
 	}
+	return 0;
+}
+
+/*
+ * Track a change to the list. With PRE_ERASE the first change since the
+ * last commit erases the standby section, so the commit only programs.
+ * Until then standby keeps the previous generation as fallback. Log
+ * commits append to the active section and don't need it.
+ */
+static void list_changed(const uint8_t* key, uint32_t key_len)
+{
+	mark_dirty(key, key_len);
+	if (IS_ENABLED(CONFIG_DR_NVRAM_PRE_ERASE) && !IS_ENABLED(CONFIG_DR_NVRAM_LOG) && !nvram->list_updated) {
+		const int err = nvram_prepare_standby();
+		if (err)
+			pr_err("nvram: failed pre-erasing standby: %d\n", err);
+	}
+	nvram->list_updated = 1;
+}
+
+/* Apply validated variable, value NULL or "" deletes */
+static int set_var(const char* varname, const char* value)
+{
+	if (!value || !strlen(value)) {
+		if (list_remove((uint8_t*) varname, strlen(varname) + 1))
+			list_changed((uint8_t*) varname, strlen(varname) + 1);
+		return 0;
+	}
 
 	const char *_val = nvram_get(varname);
 	if (_val && !strcmp(_val, value)) {
@@ -306,28 +1875,273 @@ int nvram_set(const char* varname, const char* value)
 	entry.key_len = strlen(varname) + 1;
 	entry.value = (uint8_t*) value;
 	entry.value_len = strlen(value) + 1;
-	r = libnvram_list_set(&nvram->list, &entry);
+	const int r = list_set(&entry);
 	if (r) {
-		pr_err("nvram list_set libnvram_error: %d\n", r);
+		pr_err("nvram: list set failed: %d\n", r);
 		return 1;
 	}
+	list_changed(entry.key, entry.key_len);
+	return 0;
+}
+
+int nvram_set(const char* varname, const char* value)
+{
+	if (!varname)
+		return 1;
+
+	int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return 1;
+	}
+
+	if (validate_var(sys_prefix, varname, value))
+		return 1;
+
+	return set_var(varname, value);
+}
+
+static int set_batch(const char* prefix, const char* const* vars, int count)
+{
+	if (!vars || count < 1)
+		return 1;
+
+	int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return 1;
+	}
+
+	/* Validate everything and reserve worst case arena use up front,
+	 * applying can then no longer fail half way through. */
+	size_t reserve = 0;
+	for (int i = 0; i < count; ++i) {
+		const char *varname = vars[2 * i];
+		const char *value = vars[2 * i + 1];
+		if (validate_var(prefix, varname, value))
+			return 1;
+		reserve += ALIGN(sizeof(struct nvram_node) + strlen(varname) + 1 + (value ? strlen(value) + 1 : 0), ARENA_ALIGN);
+		if (IS_ENABLED(CONFIG_DR_NVRAM_LOG))
+			reserve += ALIGN(sizeof(struct nvram_dirty) + strlen(varname) + 1, ARENA_ALIGN);
+	}
+	if (arena_reserve(&nvram->arena, reserve)) {
+		pr_err("nvram: failed reserving %zu bytes for batch\n", reserve);
+		return 1;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		if (set_var(vars[2 * i], vars[2 * i + 1]))
+			return 1;
+	}
 
-	nvram->list_updated = 1;
 	return 0;
 }
 
+int nvram_set_batch(const char* const* vars, int count)
+{
+	return set_batch(sys_prefix, vars, count);
+}
+
+int nvram_set_batch_prefix(const char* prefix, const char* const* vars, int count)
+{
+	if (!prefix || !strlen(prefix))
+		return 1;
+	return set_batch(prefix, vars, count);
+}
+
 int nvram_set_ulong(const char* varname, ulong value)
 {
 	char *str = simple_itoa(value);
 	return nvram_set(varname, str);
 }
 
+nvram_key_t nvram_lookup(const char* varname)
+{
+	if (!varname)
+		return NULL;
+	const uint32_t len = strlen(varname) + 1;
+	for (struct nvram_key *cur = keys; cur; cur = cur->next) {
+		if (cur->key_len == len && !memcmp(cur->key, varname, len))
+			return cur;
+	}
+
+	struct nvram_key *key = malloc(sizeof(struct nvram_key) + len);
+	if (!key) {
+		pr_err("nvram: failed allocating key %s\n", varname);
+		return NULL;
+	}
+	memset(key, 0, sizeof(struct nvram_key));
+	key->key_len = len;
+	memcpy(key->key, varname, len);
+	key->next = keys;
+	keys = key;
+	return key;
+}
+
+char *nvram_get_h(nvram_key_t key)
+{
+	if (!key)
+		return NULL;
+
+	const int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return NULL;
+	}
+
+	if (key->generation != list_generation) {
+		struct libnvram_entry *entry = list_get((uint8_t*) key->key, key->key_len);
+		key->value = entry && is_printable_string(entry->value, entry->value_len) ? (char*) entry->value : NULL;
+		key->ulong_cached = 0;
+		key->generation = list_generation;
+	}
+	return key->value;
+}
+
+ulong nvram_get_ulong_h(nvram_key_t key, int base, ulong default_value)
+{
+	const char *str = nvram_get_h(key);
+	if (!str)
+		return default_value;
+	if (!key->ulong_cached || key->ulong_base != base) {
+		key->ulong_value = simple_strtoul(str, NULL, base);
+		key->ulong_base = base;
+		key->ulong_cached = 1;
+	}
+	return key->ulong_value;
+}
+
+int nvram_set_h(nvram_key_t key, const char* value)
+{
+	if (!key)
+		return 1;
+
+	int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return 1;
+	}
+
+	if (validate_var(sys_prefix, key->key, value))
+		return 1;
+
+	const char *_val = nvram_get_h(key);
+	if (value && _val && !strcmp(_val, value)) {
+		// already equal
+		return 0;
+	}
+	return set_var(key->key, value);
+}
+
+int nvram_set_ulong_h(nvram_key_t key, ulong value)
+{
+	char *str = simple_itoa(value);
+	return nvram_set_h(key, str);
+}
+
 int nvram_set_env(const char* varname, const char* envname)
 {
 	const char* var = nvram_get(varname);
 	return var ? env_set(envname, var) : 1;
 }
 
+/* Returns env name length of entry after rename, 0 if entry not imported */
+static size_t import_name_len(const struct libnvram_entry* entry, const char* prefix,
+			const char* from, const char* to)
+{
+	const char* key = (const char*) entry->key;
+	if (!is_printable_string(entry->key, entry->key_len)
+		|| !is_printable_string(entry->value, entry->value_len)
+		|| strchr(key, '=')) {
+		return 0;
+	}
+	if (!starts_with(key, prefix)) {
+		return 0;
+	}
+	size_t len = entry->key_len - 1;
+	if (starts_with(key, from)) {
+		len = len - strlen(from) + strlen(to);
+	}
+	return len;
+}
+
+int nvram_import_env(const char* prefix, const char* from, const char* to, int flag)
+{
+	int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return r;
+	}
+	if (!prefix) {
+		prefix = "";
+	}
+	if (!from || !to) {
+		from = "";
+		to = "";
+	}
+
+	// "name=value\0" for all entries, sized in first pass
+	size_t size = 0;
+	for (struct libnvram_list* cur = nvram->list; cur; cur = cur->next) {
+		const size_t len = import_name_len(cur->entry, prefix, from, to);
+		if (len) {
+			size += len + 1 + cur->entry->value_len;
+		}
+	}
+	if (!size) {
+		return -ENOENT;
+	}
+	char* buf = malloc(size);
+	if (!buf) {
+		return -ENOMEM;
+	}
+	char* pos = buf;
+	for (struct libnvram_list* cur = nvram->list; cur; cur = cur->next) {
+		if (!import_name_len(cur->entry, prefix, from, to)) {
+			continue;
+		}
+		const char* key = (const char*) cur->entry->key;
+		if (starts_with(key, from)) {
+			pos += sprintf(pos, "%s%s", to, key + strlen(from));
+		}
+		else {
+			pos += sprintf(pos, "%s", key);
+		}
+		pos += sprintf(pos, "=%s", (const char*) cur->entry->value) + 1;
+	}
+
+	if (!himport_r(&env_htab, buf, size, '\0', flag, 0, 0, NULL)) {
+		pr_err("nvram: env import failed\n");
+		r = -EINVAL;
+	}
+	free(buf);
+	return r;
+}
+
+int nvram_get_stats(struct nvram_stats* stats)
+{
+	const int r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return r;
+	}
+	stats->section_len = nvram->section_len;
+	stats->arena_used = nvram->arena.used;
+	stats->arena_high_water = nvram->arena.high_water;
+	stats->arena_blocks = nvram->arena.blocks;
+	stats->image_len = nvram->image_len;
+	stats->list_len = libnvram_serialize_size(nvram->list, LIBNVRAM_TYPE_LIST);
+	stats->init_us = nvram->init_us;
+	stats->commit_us = nvram->commit_us;
+	stats->pending = nvram->list_updated;
+	stats->read_bytes = io.read_bytes;
+	stats->program_bytes = io.program_bytes;
+	stats->erase_bytes = io.erase_bytes;
+	stats->erase_ops = io.erase_ops;
+	stats->erase_skipped = io.erase_skipped;
+	return 0;
+}
+
 struct libnvram_list* const nvram_get_list(void)
 {
 	const int r = nvram_init();
@@ -337,3 +2151,227 @@ struct libnvram_list* const nvram_get_list(void)
 	}
 	return nvram->list;
 }
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_FDT)
+/*
+ * List is serialized anew rather than passing the section, which may be
+ * mapped flash, compressed or followed by log records.
+ */
+int nvram_fdt_fixup(void* blob)
+{
+	/* Pass what is in flash, deferred changes included */
+	int r = 0;
+	if (IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT)) {
+		r = nvram_flush();
+		if (r && r != -ENXIO)
+			return r;
+	}
+	r = nvram_init();
+	if (r) {
+		pr_err("nvram: init failed [%d]\n", r);
+		return r;
+	}
+	if (nvram->list_updated)
+		return -EBUSY;
+	if (nvram->trans.active == LIBNVRAM_ACTIVE_NONE)
+		return 0;
+
+	struct libnvram_header hdr = *active_hdr();
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	const uint32_t size = libnvram_serialize_size(nvram->list, LIBNVRAM_TYPE_LIST);
+	uint8_t *buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+	if (!libnvram_serialize(nvram->list, buf, size, &hdr)) {
+		r = -ENOMEM;
+		goto exit;
+	}
+
+	/* Room for the image plus three property headers and names */
+	r = fdt_increase_size(blob, size + 128);
+	if (r < 0)
+		goto fdt_error;
+	const int node = fdt_find_or_add_subnode(blob, 0, "chosen");
+	if (node < 0) {
+		r = node;
+		goto fdt_error;
+	}
+	r = fdt_setprop(blob, node, "dr,nvram", buf, size);
+	if (!r)
+		r = fdt_setprop_u32(blob, node, "dr,nvram-counter", hdr.user);
+	if (!r)
+		r = fdt_setprop_string(blob, node, "dr,nvram-active", active_str(nvram->trans.active));
+	if (!r)
+		goto exit;
+
+fdt_error:
+	pr_err("nvram: failed updating /chosen: %s\n", fdt_strerror(r));
+	r = -ENOSPC;
+exit:
+	free(buf);
+	return r;
+}
+
+#endif
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_FDT) || IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT)
+/*
+ * Runs on every boot with a devicetree, bootm, booti and bootz included,
+ * so deferred changes are written here at the latest.
+ */
+static int nvram_ft_fixup(void* ctx, struct event* event)
+{
+	if (IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT)) {
+		const int err = nvram_flush();
+		if (err && err != -ENXIO)
+			pr_err("nvram: deferred commit failed [%d]\n", err);
+	}
+#if IS_ENABLED(CONFIG_DR_NVRAM_FDT)
+	void *blob = oftree_lookup_fdt(event->data.ft_fixup.tree);
+	/* Userspace falls back to reading flash, don't fail the boot */
+	if (!blob) {
+		pr_err("nvram: no flat devicetree, not passed to OS\n");
+		return 0;
+	}
+	const int r = nvram_fdt_fixup(blob);
+	if (r == -EBUSY)
+		pr_info("nvram: uncommitted changes, not passed to OS\n");
+	else
+	if (r)
+		pr_err("nvram: not passed to OS [%d]\n", r);
+#endif
+	return 0;
+}
+EVENT_SPY(EVT_FT_FIXUP, nvram_ft_fixup);
+#endif
+
+#if IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)
+/*
+ * Unary counter in first erase block of CONFIG_DR_NVRAM_BOOT_COUNTER_PART.
+ * Each increment programs one more bit to 0, lowest bit first and bytes in
+ * ascending order, so only reset erases.
+ */
+struct nvram_counter {
+	struct mtd_info *mtd;
+	loff_t pos; /* First byte with bits left */
+	uint8_t byte; /* Value of byte at pos */
+	ulong count;
+};
+
+static struct nvram_counter counter;
+
+static int counter_open(void)
+{
+	if (counter.mtd)
+		return 0;
+
+	struct mtd_info *mtd = NULL;
+	if (!probe_nvram_device())
+		mtd = get_mtd_by_partname(CONFIG_DR_NVRAM_BOOT_COUNTER_PART);
+	if (!mtd) {
+		mtd_probe_devices();
+		mtd = get_mtd_by_partname(CONFIG_DR_NVRAM_BOOT_COUNTER_PART);
+	}
+	if (!mtd) {
+		pr_err("nvram: %s partition not found\n", CONFIG_DR_NVRAM_BOOT_COUNTER_PART);
+		return -ENODEV;
+	}
+	if (!(mtd->flags & MTD_BIT_WRITEABLE)) {
+		pr_err("nvram: %s does not support bit programming\n", mtd->name);
+		return -EOPNOTSUPP;
+	}
+
+	uint8_t buf[BLANK_CHECK_CHUNK];
+	size_t retlen = 0;
+	loff_t offset = 0;
+	counter.count = 0;
+	counter.pos = mtd->erasesize;
+	counter.byte = 0;
+	while (offset < mtd->erasesize && counter.pos == mtd->erasesize) {
+		const size_t chunk = min((size_t) (mtd->erasesize - offset), sizeof(buf));
+		int r = mtd_read(mtd, offset, chunk, &retlen, buf);
+		io.read_bytes += retlen;
+		if (r != 0 || retlen != chunk) {
+			pr_err("nvram: failed reading %s: %d\n", mtd->name, r);
+			return r ? r : -EIO;
+		}
+		for (size_t i = 0; i < chunk; ++i) {
+			if (buf[i]) {
+				counter.pos = offset + i;
+				counter.byte = buf[i];
+				counter.count += 8 - hweight8(buf[i]);
+				break;
+			}
+			counter.count += 8;
+		}
+		offset += chunk;
+	}
+	counter.mtd = mtd;
+
+	return 0;
+}
+
+int nvram_counter_get(ulong* count)
+{
+	const int r = counter_open();
+	if (r)
+		return r;
+	*count = counter.count;
+	return 0;
+}
+
+int nvram_counter_inc(void)
+{
+	int r = counter_open();
+	if (r)
+		return r;
+
+	struct mtd_info *mtd = counter.mtd;
+	if (counter.pos >= mtd->erasesize)
+		return -ENOSPC;
+
+	/* Program whole write unit, bytes before pos are 0 and after are blank */
+	const loff_t unit = counter.pos & ~((loff_t) mtd->writesize - 1);
+	const uint8_t byte = counter.byte & (counter.byte - 1);
+	uint8_t *buf = malloc(mtd->writesize);
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0x00, counter.pos - unit);
+	buf[counter.pos - unit] = byte;
+	memset(buf + counter.pos - unit + 1, 0xff, mtd->writesize - (counter.pos - unit) - 1);
+
+	size_t retlen = 0;
+	r = mtd_write(mtd, unit, mtd->writesize, &retlen, buf);
+	io.program_bytes += retlen;
+	free(buf);
+	if (r != 0 || retlen != mtd->writesize) {
+		pr_err("nvram: failed writing %s: %d\n", mtd->name, r);
+		return r ? r : -EIO;
+	}
+
+	counter.count++;
+	counter.byte = byte;
+	if (!byte) {
+		counter.pos++;
+		counter.byte = 0xff;
+	}
+	return 0;
+}
+
+int nvram_counter_reset(void)
+{
+	int r = counter_open();
+	if (r)
+		return r;
+	if (!counter.count)
+		return 0;
+
+	r = erase_range(counter.mtd, 0, counter.mtd->erasesize);
+	if (r)
+		return r;
+	counter.count = 0;
+	counter.pos = 0;
+	counter.byte = 0xff;
+	return 0;
+}
+#endif
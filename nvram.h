@@ -4,6 +4,9 @@
 /**
  * nvram_get() - Look up the value of an nvram variable
  *
+ * The returned value is only valid until the next nvram_set() of the
+ * variable or nvram_commit(), which rebuilds the list.
+ *
  * @varname:	Variable to look up
  * @return value of variable, or NULL if not found
  */
@@ -31,6 +34,32 @@ ulong nvram_get_ulong(const char* varname, int base, ulong default_value);
  */
 int nvram_set(const char* varname, const char* value);
 
+/**
+ * nvram_set_batch() - set several nvram variables at once
+ *
+ * All variables are validated before any of them is applied, either all
+ * or none are set. Changes are applied to the list only, call
+ * nvram_commit() once afterwards.
+ *
+ * @vars: Array of count varname/value pairs, value NULL or "" deletes
+ * @count: Number of pairs
+ * @return 0 if OK, 1 on error
+ */
+int nvram_set_batch(const char* const* vars, int count);
+
+/**
+ * nvram_set_batch_prefix() - nvram_set_batch() for another namespace
+ *
+ * As nvram_set_batch() but requires varnames prefixed with @prefix
+ * instead of "SYS_". Meant for in-tree users owning a namespace.
+ *
+ * @prefix: Required varname prefix
+ * @vars: Array of count varname/value pairs, value NULL or "" deletes
+ * @count: Number of pairs
+ * @return 0 if OK, 1 on error
+ */
+int nvram_set_batch_prefix(const char* prefix, const char* const* vars, int count);
+
 /**
  * nvram_set_ulong() - set an nvram variable to an integer
  *
@@ -51,15 +80,182 @@ int nvram_set_ulong(const char* varname, ulong value);
  */
 int nvram_set_env(const char* varname, const char* envname);
 
+/**
+ * nvram_import_env() - import nvram variables to env in one update
+ *
+ * Walks the nvram list once and imports all printable variables
+ * starting with prefix through a single himport_r().
+ * Leading from in a variable name is replaced by to in the env name,
+ * so from "SYS_" to "" strips the prefix.
+ *
+ * @prefix: Only import variables starting with prefix, NULL for all
+ * @from: Name prefix to rename, NULL for no rename
+ * @to: Replacement for from, NULL for no rename
+ * @flag: himport_r() flag, H_NOCLEAR to keep existing env
+ * @return 0 if ok, -ENOENT if no variable matched, -errno on error
+ */
+int nvram_import_env(const char* prefix, const char* from, const char* to, int flag);
+
+typedef struct nvram_key* nvram_key_t;
+
+/**
+ * nvram_lookup() - resolve variable name to handle
+ *
+ * The handle stays valid for the lifetime of U-Boot. Value, printability
+ * and parsed number are cached per handle until the variable is set or
+ * the nvram list is reloaded, sparing repeated string lookups.
+ * Looking up the same name twice returns the same handle.
+ *
+ * @varname: Variable to resolve, copied
+ * @return handle, NULL on error
+ */
+nvram_key_t nvram_lookup(const char* varname);
+
+/**
+ * nvram_get_h() - nvram_get() by handle
+ *
+ * @key: Handle from nvram_lookup()
+ * @return value of variable, or NULL if not found
+ */
+char *nvram_get_h(nvram_key_t key);
+
+/**
+ * nvram_get_ulong_h() - nvram_get_ulong() by handle
+ *
+ * @key: Handle from nvram_lookup()
+ * @base: Number base to use (normally 10, or 16 for hex)
+ * @default_value: Default value to return if variable is not found
+ * @return the value found, or @default_value if not found
+ */
+ulong nvram_get_ulong_h(nvram_key_t key, int base, ulong default_value);
+
+/**
+ * nvram_set_h() - nvram_set() by handle
+ *
+ * @key: Handle from nvram_lookup()
+ * @value: Value to set, NULL or "" to delete
+ * @return 0 if OK, 1 on error
+ */
+int nvram_set_h(nvram_key_t key, const char* value);
+
+/**
+ * nvram_set_ulong_h() - nvram_set_ulong() by handle
+ *
+ * @key: Handle from nvram_lookup()
+ * @value: Value to set for the variable (will be converted to a string)
+ * @return 0 if OK, 1 on error
+ */
+int nvram_set_ulong_h(nvram_key_t key, ulong value);
+
 /**
  * nvram_commit() - commit nvram variables to flash
  *
+ * With CONFIG_DR_NVRAM_DEFERRED_COMMIT changes are only kept for
+ * nvram_flush() right before booting the OS, at the latest on the
+ * devicetree fixup of bootm, booti or bootz.
+ *
  * @return 0 if ok, -errno on error
  */
 int nvram_commit(void);
 
+/**
+ * nvram_flush() - commit nvram variables to flash immediately
+ *
+ * Same as nvram_commit() without CONFIG_DR_NVRAM_DEFERRED_COMMIT.
+ *
+ * @return 0 if ok, -ENXIO if nvram not loaded, -errno on error
+ */
+int nvram_flush(void);
+
+/**
+ * nvram_compact() - commit nvram variables to flash as a full image
+ *
+ * Same as nvram_flush(), but with CONFIG_DR_NVRAM_LOG changes are never
+ * appended as a log record. For changes that must be visible to readers
+ * without log support.
+ *
+ * @return 0 if ok, -ENXIO if nvram not loaded, -errno on error
+ */
+int nvram_compact(void);
+
+/**
+ * nvram_prepare_standby() - erase the section written by next commit
+ *
+ * Moves the erase out of nvram_commit(), which then only programs.
+ * The previous generation held by the standby section is lost.
+ *
+ * @return 0 if ok, -errno on error
+ */
+int nvram_prepare_standby(void);
+
+/**
+ * nvram_counter_get() - read boot counter
+ *
+ * Unary counter in its own partition, see CONFIG_DR_NVRAM_BOOT_COUNTER.
+ *
+ * @count: Filled in on success
+ * @return 0 if ok, -errno on error
+ */
+int nvram_counter_get(ulong* count);
+
+/**
+ * nvram_counter_inc() - increment boot counter
+ *
+ * Programs a single bit, no erase and no nvram_commit() needed.
+ *
+ * @return 0 if ok, -ENOSPC if counter is full, -errno on error
+ */
+int nvram_counter_inc(void);
+
+/**
+ * nvram_counter_reset() - reset boot counter to 0
+ *
+ * Erases the counter, unless already 0.
+ *
+ * @return 0 if ok, -errno on error
+ */
+int nvram_counter_reset(void);
+
+struct nvram_stats {
+	size_t section_len;      /* Size of active section held in memory */
+	size_t arena_used;       /* Bytes currently allocated from arena */
+	size_t arena_high_water; /* Max arena bytes allocated since init */
+	uint32_t arena_blocks;   /* Arena blocks allocated since init */
+	size_t image_len;        /* Size of active image in flash */
+	size_t list_len;         /* Size of list serialized uncompressed */
+	ulong init_us;           /* Time to load and deserialize */
+	ulong commit_us;         /* Time of last commit writing flash, 0 if none */
+	int pending;             /* Changes not written to flash yet */
+	/* Flash traffic since boot, boot counter included */
+	uint64_t read_bytes;
+	uint64_t program_bytes;
+	uint64_t erase_bytes;
+	uint32_t erase_ops;      /* Erase operations, consecutive blocks erased at once */
+	uint32_t erase_skipped;  /* Erase blocks found blank and not erased */
+};
+
+/**
+ * nvram_get_stats() - Get nvram memory and timing statistics
+ *
+ * @stats: Filled in on success
+ * @return 0 if ok, -errno on error
+ */
+int nvram_get_stats(struct nvram_stats* stats);
+
+/**
+ * nvram_fdt_fixup() - pass committed nvram list to the OS in /chosen
+ *
+ * Called from the devicetree fixup of bootm/booti with
+ * CONFIG_DR_NVRAM_FDT, see there for the properties set.
+ *
+ * @blob: Devicetree to fix up
+ * @return 0 if ok, -EBUSY with uncommitted changes, -errno on error
+ */
+int nvram_fdt_fixup(void* blob);
+
 /**
  * nvram_get_list() - Get nvram_list
+ * Only valid until next nvram_commit()
  * @return NULL if not OK
  */
 struct libnvram_list* const nvram_get_list(void);
@@ -1,8 +1,19 @@
 #include <common.h>
 #include <command.h>
+#include <search.h>
+#include <inttypes.h>
 #include "nvram.h"
 #include "libnvram/libnvram.h"
 
+/* Deferred changes are lost on reset or poweroff, only written on boot */
+static void warn_deferred(void)
+{
+	struct nvram_stats stats;
+	if (IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT) && !nvram_get_stats(&stats) && stats.pending) {
+		printf("nvram: commit deferred until OS boot, use \"nvram commit --now\" before reset\n");
+	}
+}
+
 static int do_nvram(struct cmd_tbl* cmdtp, int flag, int argc,
 			char * const argv[])
 {
@@ -28,29 +39,106 @@ static int do_nvram(struct cmd_tbl* cmdtp, int flag, int argc,
 	}
 	else
 	if (strncmp(argv[1], "set", 3) == 0) {
-		if (argc != 4) {
+		int nargs = argc - 2;
+		const int commit = nargs > 0 && strcmp(argv[argc - 1], "--commit") == 0;
+		if (commit) {
+			nargs--;
+		}
+		if (nargs < 2 || nargs % 2) {
 			return CMD_RET_USAGE;
 		}
-		if (nvram_set(argv[2], argv[3])) {
+		if (nvram_set_batch((const char* const*) &argv[2], nargs / 2)) {
+			return CMD_RET_FAILURE;
+		}
+		if (commit) {
+			if (nvram_commit()) {
+				return CMD_RET_FAILURE;
+			}
+			warn_deferred();
+		}
+	}
+	else
+	if (strncmp(argv[1], "import", 6) == 0) {
+		const char* prefix = NULL;
+		/* Split from:to in a copy, argv may be reused by the caller */
+		char rename[CONFIG_SYS_CBSIZE];
+		char* from = NULL;
+		char* to = NULL;
+		for (int i = 2; i < argc; ++i) {
+			if (strcmp(argv[i], "--rename") == 0) {
+				if (++i >= argc || strlcpy(rename, argv[i], sizeof(rename)) >= sizeof(rename)
+					|| !(to = strchr(rename, ':'))) {
+					return CMD_RET_USAGE;
+				}
+				from = rename;
+				*to++ = '\0';
+			}
+			else
+			if (!prefix) {
+				prefix = argv[i];
+			}
+			else {
+				return CMD_RET_USAGE;
+			}
+		}
+		if (nvram_import_env(prefix, from, to, H_NOCLEAR)) {
 			return CMD_RET_FAILURE;
 		}
 	}
 	else
 	if (strncmp(argv[1], "commit", 6) == 0) {
-		if (nvram_commit()) {
+		if (argc > 3 || (argc == 3 && strcmp(argv[2], "--now"))) {
+			return CMD_RET_USAGE;
+		}
+		if ((argc == 3 ? nvram_flush() : nvram_commit())) {
+			return CMD_RET_FAILURE;
+		}
+		warn_deferred();
+	}
+	else
+	if (strncmp(argv[1], "prepare", 7) == 0) {
+		if (nvram_prepare_standby()) {
+			return CMD_RET_FAILURE;
+		}
+	}
+	else
+	if (strncmp(argv[1], "info", 4) == 0) {
+		struct nvram_stats stats;
+		if (nvram_get_stats(&stats)) {
 			return CMD_RET_FAILURE;
 		}
+		printf("section:    %zu bytes\n", stats.section_len);
+		printf("arena used: %zu bytes\n", stats.arena_used);
+		printf("arena peak: %zu bytes\n", stats.arena_high_water);
+		printf("arena blks: %" PRIu32 "\n", stats.arena_blocks);
+		printf("image:      %zu bytes\n", stats.image_len);
+		printf("list:       %zu bytes\n", stats.list_len);
+		printf("init:       %lu us\n", stats.init_us);
+		printf("commit:     %lu us\n", stats.commit_us);
+		printf("pending:    %s\n", stats.pending ? "yes" : "no");
+		printf("read:       %" PRIu64 " bytes\n", stats.read_bytes);
+		printf("programmed: %" PRIu64 " bytes\n", stats.program_bytes);
+		printf("erased:     %" PRIu64 " bytes in %" PRIu32 " ops, %" PRIu32 " blank blocks skipped\n",
+				stats.erase_bytes, stats.erase_ops, stats.erase_skipped);
 	}
 
 	return CMD_RET_SUCCESS;
 }
 
 U_BOOT_CMD(
-	nvram, 4, 1, do_nvram, "nvram interface",
+	nvram, CONFIG_SYS_MAXARGS, 1, do_nvram, "nvram interface",
 	"nvram get <key>            - Read value\n"
-	"nvram set <key> <value>    - Write value\n"
+	"nvram set <key> <value> [<key> <value> ...] [--commit]\n"
+	"                           - Write values, all or none, optionally commit\n"
 	"nvram list                 - List all values\n"
-	"nvram commit               - Commit changes to flash\n"
+	"nvram import [<prefix>] [--rename <from>:<to>]\n"
+	"                           - Copy values to env, optionally only <prefix>\n"
+	"                             and with leading <from> replaced by <to>\n"
+	"nvram commit [--now]       - Commit changes to flash, with deferred\n"
+	"                             commit only --now writes immediately\n"
+	"nvram prepare              - Erase standby section ahead of commit\n"
+	"nvram info                 - Show memory usage, timing and flash traffic\n"
 	"\n"
-	"Note: No changes will be made to flash before calling commit\n"
+	"Note: Values are not written to flash before calling commit, only\n"
+	"      prepare erases the standby section, the active one is untouched\n"
 	);
@@ -0,0 +1,29 @@
+#ifndef __DR_NVRAM_HANDOFF_H__
+#define __DR_NVRAM_HANDOFF_H__
+
+#include <stdint.h>
+#include "libnvram/libnvram.h"
+
+/*
+ * Bloblist entry CONFIG_BLOBLIST_DR_NVRAM, published by SPL and consumed
+ * by nvram_init() in U-Boot proper instead of reading flash.
+ */
+struct nvram_handoff {
+	struct libnvram_transaction trans;
+	/* Active section, header included. Zero if none active */
+	uint32_t section_len;
+	uint8_t section[];
+};
+
+/**
+ * nvram_spl_handoff() - read nvram and publish it for U-Boot proper
+ *
+ * To be called from board SPL code once bloblist and SPI flash are available.
+ * Nothing is published if a section can't be read or doesn't fit
+ * CONFIG_SPL_DR_NVRAM_BUF_SIZE.
+ *
+ * @return 0 if ok, -errno on error
+ */
+int nvram_spl_handoff(void);
+
+#endif // __DR_NVRAM_HANDOFF_H__
@@ -0,0 +1,170 @@
+#include <common.h>
+#include <bloblist.h>
+#include <errno.h>
+#include <spi.h>
+#include <spi_flash.h>
+#include <linux/ctype.h>
+#include "nvram.h"
+#include "nvram_handoff.h"
+#include "libnvram/libnvram.h"
+
+/*
+ * Read-only nvram for SPL, no heap and no commit path.
+ * Sections are loaded once into static buffers and looked up in their
+ * serialized form, only nvram_get() and nvram_get_ulong() are provided.
+ */
+struct nvram_spl {
+	int loaded;
+	int error; /* Result of a failed load, not retried */
+	struct libnvram_transaction trans;
+	const uint8_t *section;
+	uint32_t section_len;
+};
+
+static uint8_t section_buf[2][CONFIG_SPL_DR_NVRAM_BUF_SIZE];
+static struct nvram_spl nvram;
+
+static uint32_t letou32(const uint8_t* le)
+{
+	return (uint32_t) le[3] << 24 | le[2] << 16 | le[1] << 8 | le[0];
+}
+
+/* Read header first and only fetch the payload length it declares */
+static int read_section(struct spi_flash* flash, u32 offset, uint8_t* buf, uint32_t* len)
+{
+	const uint32_t hdr_len = libnvram_header_len();
+	struct libnvram_header hdr;
+
+	*len = 0;
+	int r = spi_flash_read(flash, offset, hdr_len, buf);
+	if (r) {
+		printf("nvram: failed reading offset 0x%x: %d\n", offset, r);
+		return r;
+	}
+	*len = hdr_len;
+	if (libnvram_validate_header(buf, hdr_len, &hdr))
+		return 0;
+	/*
+	 * A valid section that doesn't fit must not be reported as empty,
+	 * it would be taken as the active or standby section and handed off.
+	 */
+	if (hdr.len > CONFIG_SPL_DR_NVRAM_BUF_SIZE - hdr_len) {
+		printf("nvram: offset 0x%x: %u bytes exceeds buffer\n", offset, hdr.len);
+		return -EFBIG;
+	}
+	r = spi_flash_read(flash, offset + hdr_len, hdr.len, buf + hdr_len);
+	if (r) {
+		printf("nvram: failed reading offset 0x%x: %d\n", offset, r);
+		return r;
+	}
+	*len += hdr.len;
+
+	return 0;
+}
+
+static int nvram_init(void)
+{
+	uint32_t len_a = 0;
+	uint32_t len_b = 0;
+
+	if (nvram.loaded)
+		return 0;
+	if (nvram.error)
+		return nvram.error;
+
+	struct spi_flash *flash = spi_flash_probe(CONFIG_SF_DEFAULT_BUS, CONFIG_SF_DEFAULT_CS,
+						CONFIG_SF_DEFAULT_SPEED, CONFIG_SF_DEFAULT_MODE);
+	if (!flash) {
+		printf("nvram: spi flash probe failed\n");
+		nvram.error = -ENODEV;
+		return nvram.error;
+	}
+
+	int r = read_section(flash, CONFIG_SPL_DR_NVRAM_SYSTEM_A_OFFSET, section_buf[0], &len_a);
+	if (!r)
+		r = read_section(flash, CONFIG_SPL_DR_NVRAM_SYSTEM_B_OFFSET, section_buf[1], &len_b);
+	if (r) {
+		nvram.error = r;
+		return r;
+	}
+
+	libnvram_init_transaction(&nvram.trans, section_buf[0], len_a, section_buf[1], len_b);
+	if ((nvram.trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A) {
+		nvram.section = section_buf[0];
+		nvram.section_len = len_a;
+	}
+	else
+	if ((nvram.trans.active & LIBNVRAM_ACTIVE_B) == LIBNVRAM_ACTIVE_B) {
+		nvram.section = section_buf[1];
+		nvram.section_len = len_b;
+	}
+	nvram.loaded = 1;
+
+	return 0;
+}
+
+static int is_printable_string(const uint8_t* buf, uint32_t size)
+{
+	if (!size || strnlen((const char*) buf, size) != size - 1) {
+		return 0;
+	}
+	for (uint32_t i = 0; i < size - 1; ++i) {
+		if (!isprint(buf[i]) && !isblank(buf[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Walk serialized list: [key_len:le32][value_len:le32][key][value] */
+char *nvram_get(const char* varname)
+{
+	if (!varname || nvram_init() || !nvram.section)
+		return NULL;
+
+	const uint32_t varname_len = strlen(varname) + 1;
+	const uint8_t *data = nvram.section + libnvram_header_len();
+	const uint32_t size = nvram.section_len - libnvram_header_len();
+	uint32_t pos = 0;
+	while (size - pos >= 2 * sizeof(uint32_t)) {
+		const uint32_t key_len = letou32(data + pos);
+		const uint32_t value_len = letou32(data + pos + sizeof(uint32_t));
+		pos += 2 * sizeof(uint32_t);
+		if (key_len > size - pos || value_len > size - pos - key_len)
+			return NULL;
+		if (key_len == varname_len && !memcmp(data + pos, varname, key_len)) {
+			const uint8_t *value = data + pos + key_len;
+			return is_printable_string(value, value_len) ? (char*) value : NULL;
+		}
+		pos += key_len + value_len;
+	}
+	return NULL;
+}
+
+ulong nvram_get_ulong(const char* varname, int base, ulong default_value)
+{
+	const char *str = nvram_get(varname);
+	return str ? simple_strtoul(str, NULL, base) : default_value;
+}
+
+#if CONFIG_IS_ENABLED(DR_NVRAM_HANDOFF)
+int nvram_spl_handoff(void)
+{
+	/* Nothing is published on failure, U-Boot proper then reads flash */
+	int r = nvram_init();
+	if (r)
+		return r;
+
+	struct nvram_handoff *handoff = bloblist_add(CONFIG_BLOBLIST_DR_NVRAM, sizeof(struct nvram_handoff) + nvram.section_len, 0);
+	if (!handoff) {
+		printf("nvram: failed adding bloblist entry\n");
+		return -ENOSPC;
+	}
+	handoff->trans = nvram.trans;
+	handoff->section_len = nvram.section ? nvram.section_len : 0;
+	if (handoff->section_len)
+		memcpy(handoff->section, nvram.section, nvram.section_len);
+
+	return 0;
+}
+#endif
@@ -1,8 +1,8 @@
 #include <errno.h>
 #include <stdint.h>
 #include <string.h>
-#include <u-boot/zlib.h>
 #include "platform_header.h"
+#include "dr_crc32.h"
 
 #define MEMBER_SIZE(type, member) sizeof(((type *)0)->member)
 
@@ -24,8 +24,7 @@ int parse_header(struct platform_header* header, const uint8_t* buf, size_t size
 
 	/* header */
 	header->hdr_crc32 = letou32(buf + offsetof(struct platform_header, hdr_crc32));
-	const uint32_t crc32_init = crc32(0L, Z_NULL, 0);
-	const uint32_t crc32_calc = crc32(crc32_init, buf, offsetof(struct platform_header, hdr_crc32));
+	const uint32_t crc32_calc = dr_crc32(0, buf, offsetof(struct platform_header, hdr_crc32));
 	if (header->hdr_crc32 != crc32_calc)
 		return -EINVAL;
 	header->hdr_magic = letou32(buf + offsetof(struct platform_header, hdr_magic));
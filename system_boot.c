@@ -7,6 +7,7 @@
 #include <command.h>
 #include <fs.h>
 #include "nvram.h"
+#include "dr_bootstage.h"
 
 static const char* sys_boot_part = "SYS_BOOT_PART";
 static const char* sys_boot_swap = "SYS_BOOT_SWAP";
@@ -14,6 +15,27 @@ static const char* sys_boot_attempts = "SYS_BOOT_ATTEMPTS";
 static const char* sys_fit_conf = "SYS_FIT_CONF";
 static const char* syslabel_default = "rootfs1";
 
+static nvram_key_t key_boot_part;
+static nvram_key_t key_boot_swap;
+static nvram_key_t key_boot_attempts;
+static nvram_key_t key_fit_conf;
+
+/* Resolve nvram keys once, lookups are cached per key */
+static int lookup_keys(void)
+{
+	if (!key_boot_part)
+		key_boot_part = nvram_lookup(sys_boot_part);
+	if (!key_boot_swap)
+		key_boot_swap = nvram_lookup(sys_boot_swap);
+	if (!key_boot_attempts)
+		key_boot_attempts = nvram_lookup(sys_boot_attempts);
+	if (!key_fit_conf)
+		key_fit_conf = nvram_lookup(sys_fit_conf);
+	if (!key_boot_part || !key_boot_swap || !key_boot_attempts || !key_fit_conf)
+		return -ENOMEM;
+	return 0;
+}
+
 
 enum swap_state {
 	SWAP_NORMAL,
@@ -26,20 +48,27 @@ enum swap_state {
 
 static enum swap_state find_state(ulong* attempts)
 {
-	if (!nvram_get(sys_boot_part) || !nvram_get(sys_boot_swap))
+	if (!nvram_get_h(key_boot_part) || !nvram_get_h(key_boot_swap))
 		return SWAP_INVAL;
 
-	const int part_swap_equal = !strcmp(nvram_get(sys_boot_part), nvram_get(sys_boot_swap));
-	if (part_swap_equal && !nvram_get(sys_boot_attempts))
+	const int part_swap_equal = !strcmp(nvram_get_h(key_boot_part), nvram_get_h(key_boot_swap));
+	if (part_swap_equal && !nvram_get_h(key_boot_attempts))
 		return SWAP_NORMAL;
 
-	if (part_swap_equal && nvram_get(sys_boot_attempts))
+	if (part_swap_equal && nvram_get_h(key_boot_attempts))
 		return SWAP_ROLLBACK;
 
-	if (!nvram_get(sys_boot_attempts))
+	if (!nvram_get_h(key_boot_attempts))
 		return SWAP_INIT;
 
-	*attempts = nvram_get_ulong(sys_boot_attempts, 10, ULONG_MAX);
+	/* With boot counter SYS_BOOT_ATTEMPTS only marks an ongoing swap */
+	if (IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)) {
+		if (nvram_counter_get(attempts))
+			return SWAP_INVAL;
+	}
+	else {
+		*attempts = nvram_get_ulong_h(key_boot_attempts, 10, ULONG_MAX);
+	}
 	if (*attempts == ULONG_MAX)
 		return SWAP_INVAL;
 
@@ -51,49 +80,86 @@ static enum swap_state find_state(ulong* attempts)
 
 static int nvram_root_swap(char** rootfs_label)
 {
-	char* label = nvram_get(sys_boot_part);
+	if (lookup_keys())
+		return -ENOMEM;
+
+	/* Values are only valid until commit, look up label after it */
+	nvram_key_t label_key = key_boot_part;
 	ulong attempts = ULONG_MAX;
+	int r = 0;
 
-	switch(find_state(&attempts)) {
+	const enum swap_state state = find_state(&attempts);
+	switch(state) {
 	case SWAP_NORMAL:
 		printf("BOOT: normal boot\n");
+		/* Swap completed, erases only if counter was used */
+		if (IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER) && nvram_counter_reset())
+			printf("BOOT: failed resetting boot counter\n");
 		break;
 	case SWAP_INIT:
 		printf("BOOT: root swap initiated\n");
-		nvram_set_ulong(sys_boot_attempts, 1);
-		label = nvram_get(sys_boot_swap);
+		if (IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)) {
+			r = nvram_counter_reset();
+			if (!r)
+				r = nvram_counter_inc();
+			if (r) {
+				printf("BOOT: failed setting boot counter [%d]: %s\n", r, errno_str(r));
+				return r;
+			}
+		}
+		nvram_set_ulong_h(key_boot_attempts, 1);
+		label_key = key_boot_swap;
 		break;
 	case SWAP_ONGOING:
-		nvram_set_ulong(sys_boot_attempts, ++attempts);
-		printf("BOOT: root swap ongoing: attempt: %s\n", nvram_get(sys_boot_attempts));
-		label = nvram_get(sys_boot_swap);
+		++attempts;
+		if (IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER)) {
+			/* Single bit program, nothing left to commit */
+			r = nvram_counter_inc();
+			if (r) {
+				printf("BOOT: failed incrementing boot counter [%d]: %s\n", r, errno_str(r));
+				return r;
+			}
+		}
+		else {
+			nvram_set_ulong_h(key_boot_attempts, attempts);
+		}
+		printf("BOOT: root swap ongoing: attempt: %lu\n", attempts);
+		label_key = key_boot_swap;
 		break;
 	case SWAP_FAILED:
-		printf("BOOT: root swap failed: rollback from %s to %s\n", nvram_get(sys_boot_swap), nvram_get(sys_boot_part));
-		nvram_set(sys_boot_swap, nvram_get(sys_boot_part));
+		printf("BOOT: root swap failed: rollback from %s to %s\n", nvram_get_h(key_boot_swap), nvram_get_h(key_boot_part));
+		nvram_set_h(key_boot_swap, nvram_get_h(key_boot_part));
 		break;
 	case SWAP_ROLLBACK:
 		printf("BOOT: root swap rollback has occured\n");
 		break;
 	case SWAP_INVAL:
 		printf("BOOT: root swap invalid state -- reset to defaults\n");
-		if (nvram_set(sys_boot_part, syslabel_default))
+		if (nvram_set_h(key_boot_part, syslabel_default))
 			return -ENOMEM;
-		if (nvram_set(sys_boot_swap, syslabel_default))
+		if (nvram_set_h(key_boot_swap, syslabel_default))
 			return -ENOMEM;
-		if (nvram_set(sys_boot_attempts, NULL))
+		if (nvram_set_h(key_boot_attempts, NULL))
 			return -ENOMEM;
-		label = nvram_get(sys_boot_part);
+		if (IS_ENABLED(CONFIG_DR_NVRAM_BOOT_COUNTER) && nvram_counter_reset())
+			printf("BOOT: failed resetting boot counter\n");
 		break;
 	}
 
-	const int r = nvram_commit();
+	/*
+	 * Attempts must be counted even if loading fails, don't defer.
+	 * Only the attempt increment may go to the log, libnvram in Linux
+	 * doesn't read it and would revert any other transition.
+	 */
+	r = state == SWAP_ONGOING ? nvram_flush() : nvram_compact();
 	if (r) {
 		printf("BOOT: failed commiting nvram [%d]: %s\n", r, errno_str(r));
 		return r;
 	}
 
-	*rootfs_label = label;
+	*rootfs_label = nvram_get_h(label_key);
+	if (!*rootfs_label)
+		return -ENOENT;
 	return 0;
 }
 
@@ -119,7 +185,9 @@ static int load_fit(const char* interface, int device, int part, const char* lab
 	int partnr = -1;
 	/* Search by label first, if provided */
 	if (label) {
+		dr_bootstage_start(DR_BOOTSTAGE_PART_LOOKUP);
 		partnr = part_get_info_by_name(dev, label, &part_info);
+		dr_bootstage_end(DR_BOOTSTAGE_PART_LOOKUP, 0);
 	}
 	/* If not found, search by partition index, if provided */
 	if (partnr == -1 && part != -1) {
@@ -145,7 +213,9 @@ static int load_fit(const char* interface, int device, int part, const char* lab
 		return -EFAULT;
 	}
 	loff_t fit_size = 0;
+	dr_bootstage_start(DR_BOOTSTAGE_FIT_READ);
 	r = fs_read(CONFIG_DR_BOOT_IMAGE_PATH, CONFIG_DR_BOOT_IMAGE_LOADADDR, 0, 0, &fit_size);
+	dr_bootstage_end(DR_BOOTSTAGE_FIT_READ, fit_size);
 	fs_close();
 	if (r) {
 		printf("BOOT: Failed reading image\n");
@@ -178,7 +248,9 @@ static int boot_fit(const char* fit_conf)
 	sprintf(image_addr, "%lx", (unsigned long) CONFIG_DR_BOOT_IMAGE_LOADADDR);
 	int arglen = strlen(image_addr) + 1;
 	/* check optional config */
-	const char *conf = fit_conf ? fit_conf : nvram_get(sys_fit_conf);
+	if (!fit_conf && lookup_keys())
+		return -ENOMEM;
+	const char *conf = fit_conf ? fit_conf : nvram_get_h(key_fit_conf);
 	if (conf) {
 		/*     += # + conf */
 		arglen += 1 + strlen(conf);
@@ -191,6 +263,12 @@ static int boot_fit(const char* fit_conf)
 		strcat(arg, "#");
 		strcat(arg, conf);
 	}
+	/* Write nvram changes deferred during this boot */
+	if (IS_ENABLED(CONFIG_DR_NVRAM_DEFERRED_COMMIT)) {
+		const int r = nvram_flush();
+		if (r && r != -ENXIO)
+			printf("BOOT: failed commiting nvram [%d]: %s\n", r, errno_str(r));
+	}
 	char *boot_args[] = {"bootm", arg};
 	do_bootm(NULL, 0, 2, boot_args);
 	if (conf) {
@@ -219,6 +297,7 @@ static int do_system_load(struct cmd_tbl* cmdtp, int flag, int argc,
 	char* rootfs_label = NULL;
 	int partnr = -1;
 	int options = 0;
+	int timings = 0;
 	if (argc > 3) {
 		for (int i = 3; i < argc; ++i) {
 			if (strcmp(argv[i], "--label") == 0) {
@@ -236,6 +315,12 @@ static int do_system_load(struct cmd_tbl* cmdtp, int flag, int argc,
 			if (strcmp(argv[i], "--empty-root") == 0) {
 				options |= LOAD_FIT_EMPTY_ROOT;
 			}
+			else
+			if (strcmp(argv[i], "--timings") == 0) {
+				if (!IS_ENABLED(CONFIG_DR_BOOTSTAGE))
+					return CMD_RET_USAGE;
+				timings = 1;
+			}
 			else {
 				return CMD_RET_USAGE;
 			}
@@ -251,6 +336,8 @@ static int do_system_load(struct cmd_tbl* cmdtp, int flag, int argc,
 	}
 
 	r = load_fit(interface, device, partnr, rootfs_label, options);
+	if (timings)
+		dr_bootstage_report();
 	if (r) {
 		printf("BOOT: failed loading image [%d]: %s\n", r, errno_str(r));
 		return CMD_RET_FAILURE;
@@ -260,13 +347,14 @@ static int do_system_load(struct cmd_tbl* cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	system_load, 7, 1, do_system_load, "Load bootable linux to memory",
+	system_load, 9, 1, do_system_load, "Load bootable linux to memory",
 	"system_load interface device [args]   -- With root swap support\n"
 	"  Note: Increments root swap attempts variable if swap in progress\n"
 	"Args:\n"
 	"  --label      -- gpt label of root partition, disables root swap\n"
 	"  --part       -- partition index of root partition, disables root swap\n"
 	"  --empty-root -- Don't set root= kernel cmdline\n"
+	"  --timings    -- Print time and bytes per boot stage, needs CONFIG_DR_BOOTSTAGE\n"
 );
 
 static int do_system_boot(struct cmd_tbl* cmdtp, int flag, int argc,